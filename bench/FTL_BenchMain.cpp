@@ -0,0 +1,46 @@
+#include <benchmark/benchmark.h>
+#include <spdlog/sinks/null_sink.h>
+#include <utility/FTL_Log.h>
+
+namespace {
+// NOTE: The benchmarks measure what a call costs its caller, so instead of
+// the console and log file Log::init opens, the loggers write through the
+// same async pipeline into a null sink
+std::shared_ptr<FTL::AsyncLogSink> initBenchLogging() {
+    const auto nullSink = std::make_shared<spdlog::sinks::null_sink_st>();
+    const auto asyncSink = std::make_shared<FTL::AsyncLogSink>(
+        std::vector<spdlog::sink_ptr> {nullSink}, FTL::LogFlushPolicy {});
+    asyncSink->start();
+
+    FTL::Log::errLogger() = std::make_shared<spdlog::logger>(
+        "FTL::Bench", std::make_shared<spdlog::sinks::null_sink_mt>());
+    FTL::Log::stdLogger() =
+        std::make_shared<spdlog::logger>("FTL::Bench", asyncSink);
+    FTL::Log::stdLogger()->set_level(spdlog::level::trace);
+    FTL::Log::stdLogger()->flush_on(spdlog::level::off);
+
+    FTL::TraceLog::start();
+    return asyncSink;
+};
+}; // namespace
+
+int main(int argc, char **argv) {
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv))
+        return 1;
+
+    const std::shared_ptr<FTL::AsyncLogSink> asyncSink = initBenchLogging();
+
+#ifdef __FRACTAL_BUILD_RELEASE
+    benchmark::AddCustomContext("fractal_build", "release");
+#else
+    benchmark::AddCustomContext("fractal_build", "debug");
+#endif
+
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+
+    FTL::TraceLog::stop();
+    asyncSink->stop();
+    return 0;
+}
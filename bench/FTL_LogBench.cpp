@@ -0,0 +1,119 @@
+#include <benchmark/benchmark.h>
+#include <utility/FTL_Log.h>
+
+// NOTE: Caller-side cost of the FTL logging macros. FTL_TRACE copies its
+// arguments into the thread's trace buffer, FTL_INFO formats on the calling
+// thread and queues the text for the async writer. Both drop records when
+// their ring is full, so the loops run in batches that fit the rings and
+// wait, untimed, for the writers to catch up in between. A run that still
+// drops anything fails rather than report the cost of the drop path.
+namespace {
+// Fits the trace ring, and the async ring with four threads sharing it
+constexpr uint64_t BatchSize = 512;
+
+// The trace writer only drains every 5 ms, a fixed count bounds the waits
+constexpr int64_t TraceIterations = 1 << 17;
+
+FTL::AsyncLogSink &asyncSink() {
+    return static_cast<FTL::AsyncLogSink &>(
+        *FTL::Log::stdLogger()->sinks().front());
+};
+
+void waitForTrace(const FTL::TraceBuffer &buffer) {
+    while (buffer.sizeApprox() != 0)
+        std::this_thread::yield();
+};
+
+// Leaves room for one batch from every thread
+void waitForAsync(const benchmark::State &state) {
+    const std::size_t limit =
+        FTL::AsyncLogSink::QueueCapacity -
+        static_cast<std::size_t>(state.threads()) * BatchSize;
+    while (asyncSink().queueSizeApprox() > limit)
+        std::this_thread::yield();
+};
+
+void reportDropped(benchmark::State &state, uint64_t dropped) {
+    if (state.thread_index() == 0)
+        state.counters["dropped"] = static_cast<double>(dropped);
+    if (dropped != 0)
+        state.SkipWithError("Log records were dropped, the ring was full");
+};
+
+void BM_TraceInts(benchmark::State &state) {
+    const FTL::TraceBuffer &buffer = FTL::TraceLog::threadBuffer();
+    waitForTrace(buffer);
+    const uint64_t droppedBefore = buffer.droppedTotal();
+
+    uint64_t frame = 0;
+    for (auto _ : state) {
+        FTL_TRACE("frame {} pass {}", frame, 3);
+        if (++frame % BatchSize == 0) {
+            state.PauseTiming();
+            waitForTrace(buffer);
+            state.ResumeTiming();
+        }
+    }
+    reportDropped(state, buffer.droppedTotal() - droppedBefore);
+};
+BENCHMARK(BM_TraceInts)->Iterations(TraceIterations)->Threads(1)->Threads(4);
+
+void BM_TraceString(benchmark::State &state) {
+    const FTL::TraceBuffer &buffer = FTL::TraceLog::threadBuffer();
+    waitForTrace(buffer);
+    const uint64_t droppedBefore = buffer.droppedTotal();
+
+    const std::string name = "computePersistentMain";
+    uint64_t count         = 0;
+    for (auto _ : state) {
+        FTL_TRACE("dispatch {} at {:.3f}", name, 0.25);
+        if (++count % BatchSize == 0) {
+            state.PauseTiming();
+            waitForTrace(buffer);
+            state.ResumeTiming();
+        }
+    }
+    reportDropped(state, buffer.droppedTotal() - droppedBefore);
+};
+BENCHMARK(BM_TraceString)->Iterations(TraceIterations);
+
+void BM_InfoFormatted(benchmark::State &state) {
+    waitForAsync(state);
+    const uint64_t droppedBefore = asyncSink().droppedTotal();
+
+    uint64_t frame = 0;
+    for (auto _ : state) {
+        FTL_INFO("frame {} took {:.3f} ms", frame, 16.6);
+        if (++frame % BatchSize == 0) {
+            state.PauseTiming();
+            waitForAsync(state);
+            state.ResumeTiming();
+        }
+    }
+    reportDropped(state, asyncSink().droppedTotal() - droppedBefore);
+};
+BENCHMARK(BM_InfoFormatted)->Threads(1)->Threads(4);
+
+// A macro whose level is filtered out by the logger at runtime
+void BM_DebugFiltered(benchmark::State &state) {
+    FTL::Log::stdLogger()->set_level(spdlog::level::info);
+    uint64_t frame = 0;
+    for (auto _ : state) {
+        FTL_DEBUG("frame {} took {:.3f} ms", frame, 16.6);
+        ++frame;
+    }
+    FTL::Log::stdLogger()->set_level(spdlog::level::trace);
+};
+BENCHMARK(BM_DebugFiltered);
+
+void BM_TraceDisabled(benchmark::State &state) {
+    FTL::TraceLog::setEnabled(false);
+    uint64_t frame = 0;
+    for (auto _ : state) {
+        FTL_TRACE("frame {} pass {}", frame, 3);
+        ++frame;
+    }
+    FTL::TraceLog::setEnabled(true);
+};
+BENCHMARK(BM_TraceDisabled);
+}; // namespace
@@ -0,0 +1,65 @@
+#include <benchmark/benchmark.h>
+#include <gtfo_profiler.h>
+
+#include <filesystem>
+#include <string>
+
+// NOTE: Overhead of a GTFO scope in each state it can be in. The session
+// paths record every iteration, so they run a fixed number of them to keep
+// the trace file small.
+namespace {
+constexpr int64_t SessionIterations = 1 << 18;
+
+// startSession() keeps the pointers until the session ends
+const std::string TraceFile =
+    (std::filesystem::temp_directory_path() / "FractalBench.gtfo").string();
+const std::string SummaryFile =
+    (std::filesystem::temp_directory_path() / "FractalBench.txt").string();
+
+void BM_ClockNow(benchmark::State &state) {
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(GTFO::Clock::now());
+    }
+};
+BENCHMARK(BM_ClockNow);
+
+void BM_TimerNoSession(benchmark::State &state) {
+    for (auto _ : state) {
+        GTFO_PROFILE_SCOPE("BM_TimerNoSession", "bench");
+    }
+};
+BENCHMARK(BM_TimerNoSession);
+
+void BM_TimerCategoryOff(benchmark::State &state) {
+    GTFO::Profiler &profiler = GTFO::Profiler::get();
+    profiler.startSession("FractalBench", TraceFile.c_str());
+    profiler.setCategoryEnabled("bench", false);
+    for (auto _ : state) {
+        GTFO_PROFILE_SCOPE("BM_TimerCategoryOff", "bench");
+    }
+    profiler.setCategoryEnabled("bench", true);
+    profiler.endSession();
+};
+BENCHMARK(BM_TimerCategoryOff);
+
+void BM_TimerTrace(benchmark::State &state) {
+    GTFO::Profiler &profiler = GTFO::Profiler::get();
+    profiler.startSession("FractalBench", TraceFile.c_str());
+    for (auto _ : state) {
+        GTFO_PROFILE_SCOPE("BM_TimerTrace", "bench");
+    }
+    profiler.endSession();
+};
+BENCHMARK(BM_TimerTrace)->Iterations(SessionIterations);
+
+void BM_TimerAggregate(benchmark::State &state) {
+    GTFO::Profiler &profiler = GTFO::Profiler::get();
+    profiler.startSession("FractalBench", SummaryFile.c_str(),
+                          GTFO::SessionMode::Aggregate);
+    for (auto _ : state) {
+        GTFO_PROFILE_SCOPE("BM_TimerAggregate", "bench");
+    }
+    profiler.endSession();
+};
+BENCHMARK(BM_TimerAggregate)->Iterations(SessionIterations);
+}; // namespace
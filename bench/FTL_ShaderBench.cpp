@@ -0,0 +1,39 @@
+#include <benchmark/benchmark.h>
+#include <utility/FTL_File.h>
+
+// NOTE: Loading the SPIR-V modules the renderer reads at startup, up to the
+// point where the words go to vkCreateShaderModule. Creating the module
+// needs a device and is left to the renderer's own GTFO scopes.
+namespace {
+constexpr uint32_t SpirvMagic = 0x07230203;
+
+void BM_LoadSpirv(benchmark::State &state, const char *fileName) {
+    const std::string path = std::string(std::filesystem::current_path()) +
+                             "/assets/shaders/" + fileName;
+    if (!std::filesystem::exists(path)) {
+        state.SkipWithError(
+            "SPIR-V module not found, run from the repository root");
+        return;
+    }
+
+    std::size_t bytes = 0;
+    for (auto _ : state) {
+        const std::vector<char> code = FTL::readFile(path);
+
+        uint32_t magic = 0;
+        if (code.size() >= sizeof(magic))
+            std::memcpy(&magic, code.data(), sizeof(magic));
+        if (magic != SpirvMagic || code.size() % sizeof(uint32_t) != 0) {
+            state.SkipWithError("Not a SPIR-V module");
+            break;
+        }
+
+        benchmark::DoNotOptimize(code.data());
+        bytes += code.size();
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(bytes));
+};
+BENCHMARK_CAPTURE(BM_LoadSpirv, graphics, "slang.spv");
+BENCHMARK_CAPTURE(BM_LoadSpirv, kernels, "fractal.spv");
+BENCHMARK_CAPTURE(BM_LoadSpirv, kernelsSubgroup, "fractal_subgroup.spv");
+}; // namespace
@@ -0,0 +1,70 @@
+// NOTE: Replaces the global allocation functions so GTFO::Allocations sees
+// every new and delete in the program. Only built with
+// GTFO_TRACK_ALLOCATIONS, over-aligned allocations are left to the
+// standard library and not counted.
+#include "gtfo_allocations.h"
+
+#include <cstdlib>
+#include <new>
+
+namespace {
+void *allocate(std::size_t size) {
+    if (size == 0)
+        size = 1;
+
+    for (;;) {
+        void *pointer = std::malloc(size);
+        if (pointer != nullptr) {
+            GTFO::Allocations::recordAllocation(pointer);
+            return pointer;
+        }
+
+        std::new_handler handler = std::get_new_handler();
+        if (handler == nullptr)
+            throw std::bad_alloc();
+        handler();
+    }
+};
+
+void *allocateNoThrow(std::size_t size) noexcept {
+    try {
+        return allocate(size);
+    } catch (...) {
+        return nullptr;
+    }
+};
+
+void deallocate(void *pointer) noexcept {
+    GTFO::Allocations::recordFree(pointer);
+    std::free(pointer);
+};
+} // namespace
+
+void *operator new(std::size_t size) { return allocate(size); }
+void *operator new[](std::size_t size) { return allocate(size); }
+
+void *operator new(std::size_t size, const std::nothrow_t &) noexcept {
+    return allocateNoThrow(size);
+}
+void *operator new[](std::size_t size, const std::nothrow_t &) noexcept {
+    return allocateNoThrow(size);
+}
+
+void operator delete(void *pointer) noexcept { deallocate(pointer); }
+void operator delete[](void *pointer) noexcept { deallocate(pointer); }
+
+void operator delete(void *pointer, const std::nothrow_t &) noexcept {
+    deallocate(pointer);
+}
+void operator delete[](void *pointer, const std::nothrow_t &) noexcept {
+    deallocate(pointer);
+}
+
+#if defined(__cpp_sized_deallocation)
+void operator delete(void *pointer, std::size_t) noexcept {
+    deallocate(pointer);
+}
+void operator delete[](void *pointer, std::size_t) noexcept {
+    deallocate(pointer);
+}
+#endif
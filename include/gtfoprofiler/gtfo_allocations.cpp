@@ -0,0 +1,121 @@
+#include "gtfo_allocations.h"
+
+#include <cstdlib>
+#include <cstring>
+
+#if defined(__GLIBC__)
+#include <malloc.h>
+#elif defined(__APPLE__)
+#include <malloc/malloc.h>
+#elif defined(_MSC_VER)
+#include <malloc.h>
+#endif
+
+namespace GTFO {
+
+namespace {
+// NOTE: Constant-initialized, operator new can run before any dynamic
+// initializer in this translation unit
+Allocations::Slot sSlots[Allocations::MaxThreadSlots];
+std::atomic<std::size_t> sNextSlot{0};
+thread_local Allocations::Slot *tSlot = nullptr;
+
+Allocations::Slot &sharedSlot() {
+    return sSlots[Allocations::MaxThreadSlots - 1];
+};
+
+std::size_t usableSize(void *pointer) {
+#if defined(__GLIBC__)
+    return malloc_usable_size(pointer);
+#elif defined(__APPLE__)
+    return malloc_size(pointer);
+#elif defined(_MSC_VER)
+    return _msize(pointer);
+#else
+    (void)pointer;
+    return 0;
+#endif
+};
+
+// Single writer per slot except the shared one
+void add(Allocations::Slot &slot, std::atomic<uint64_t> &counter,
+         uint64_t value) {
+    if (&slot == &sharedSlot())
+        counter.fetch_add(value, std::memory_order_relaxed);
+    else
+        counter.store(counter.load(std::memory_order_relaxed) + value,
+                      std::memory_order_relaxed);
+};
+
+AllocationMode modeFromEnvironment() {
+    const char *mode = std::getenv("GTFO_ALLOCATIONS");
+    if (mode == nullptr)
+        return AllocationMode::Full;
+    if (std::strcmp(mode, "off") == 0)
+        return AllocationMode::Off;
+    if (std::strcmp(mode, "count") == 0)
+        return AllocationMode::Count;
+    return AllocationMode::Full;
+};
+
+AllocationTotals load(const Allocations::Slot &slot) {
+    AllocationTotals totals;
+    totals.allocations = slot.allocations.load(std::memory_order_relaxed);
+    totals.frees = slot.frees.load(std::memory_order_relaxed);
+    totals.allocatedBytes = slot.allocatedBytes.load(std::memory_order_relaxed);
+    totals.freedBytes = slot.freedBytes.load(std::memory_order_relaxed);
+    return totals;
+};
+} // namespace
+
+std::atomic<AllocationMode> Allocations::sMode{AllocationMode::Full};
+
+namespace {
+const bool sIsModeInitialized =
+    (Allocations::setMode(modeFromEnvironment()), true);
+} // namespace
+
+Allocations::Slot &Allocations::threadSlot() {
+    if (tSlot == nullptr) {
+        const std::size_t index =
+            sNextSlot.fetch_add(1, std::memory_order_relaxed);
+        tSlot = (index < MaxThreadSlots - 1) ? &sSlots[index] : &sharedSlot();
+    }
+    return *tSlot;
+};
+
+void Allocations::recordAllocation(void *pointer) {
+    const AllocationMode current = mode();
+    if (current == AllocationMode::Off || pointer == nullptr)
+        return;
+
+    Slot &slot = threadSlot();
+    add(slot, slot.allocations, 1);
+    if (current == AllocationMode::Full)
+        add(slot, slot.allocatedBytes, usableSize(pointer));
+};
+
+void Allocations::recordFree(void *pointer) {
+    if (mode() != AllocationMode::Full || pointer == nullptr)
+        return;
+
+    Slot &slot = threadSlot();
+    add(slot, slot.frees, 1);
+    add(slot, slot.freedBytes, usableSize(pointer));
+};
+
+AllocationTotals Allocations::thread() { return load(threadSlot()); };
+
+AllocationTotals Allocations::total() {
+    AllocationTotals totals;
+    for (std::size_t i = 0; i < MaxThreadSlots; i++) {
+        const AllocationTotals slot = load(sSlots[i]);
+        totals.allocations += slot.allocations;
+        totals.frees += slot.frees;
+        totals.allocatedBytes += slot.allocatedBytes;
+        totals.freedBytes += slot.freedBytes;
+    }
+    return totals;
+};
+
+} // namespace GTFO
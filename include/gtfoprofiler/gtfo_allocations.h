@@ -0,0 +1,84 @@
+#ifndef __GTFO_ALLOCATIONS_H
+#define __GTFO_ALLOCATIONS_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace GTFO {
+enum class AllocationMode {
+    Off,
+    Count, // number of allocations only, no sizes and no frees
+    Full,  // allocations, frees and their sizes
+};
+
+struct AllocationTotals {
+    uint64_t allocations{0};
+    uint64_t frees{0};
+    uint64_t allocatedBytes{0};
+    uint64_t freedBytes{0};
+
+    uint64_t liveBytes() const {
+        return allocatedBytes > freedBytes ? allocatedBytes - freedBytes : 0;
+    };
+};
+
+/**
+ * Counts heap allocations per thread. The global operator new/delete
+ * replacements in gtfo_allocation_hooks.cpp call in here, they are only
+ * linked when GTFO_TRACK_ALLOCATIONS is defined. Every thread owns a slot
+ * it updates with relaxed loads and stores, the totals sum all slots.
+ *
+ * Sizes are the allocator's usable size of the block, so frees balance
+ * allocations exactly. The initial mode comes from the GTFO_ALLOCATIONS
+ * environment variable ("off", "count" or "full", default "full").
+ */
+class Allocations {
+  public:
+    // NOTE: Threads beyond this share one slot updated with fetch_add
+    static const std::size_t MaxThreadSlots = 256;
+
+    struct Slot {
+        std::atomic<uint64_t> allocations{0};
+        std::atomic<uint64_t> frees{0};
+        std::atomic<uint64_t> allocatedBytes{0};
+        std::atomic<uint64_t> freedBytes{0};
+    };
+
+  private:
+    static std::atomic<AllocationMode> sMode;
+
+    static Slot &threadSlot();
+
+  public:
+    static bool isHooked() {
+#ifdef GTFO_TRACK_ALLOCATIONS
+        return true;
+#else
+        return false;
+#endif
+    };
+
+    static AllocationMode mode() {
+        return sMode.load(std::memory_order_relaxed);
+    };
+    static void setMode(AllocationMode mode) {
+        sMode.store(mode, std::memory_order_relaxed);
+    };
+    static bool isTracking() {
+        return isHooked() && mode() != AllocationMode::Off;
+    };
+
+    // Called by the hooks, must not allocate
+    static void recordAllocation(void *pointer);
+    static void recordFree(void *pointer);
+
+    // Counters of the calling thread, for per-scope deltas
+    static AllocationTotals thread();
+
+    // Sum over every thread, a little stale while other threads allocate
+    static AllocationTotals total();
+};
+}; // namespace GTFO
+
+#endif // END OF __GTFO_ALLOCATIONS_H
@@ -0,0 +1,115 @@
+#include "gtfo_categories.h"
+
+#include <cstdlib>
+
+namespace GTFO {
+
+CategoryFilter::CategoryFilter() {
+    const char *spec = std::getenv("GTFO_CATEGORIES");
+    if (spec != nullptr)
+        configure(spec);
+};
+
+CategoryMask CategoryFilter::bit(const char *category) {
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    std::size_t index = 0;
+    while (index < mNames.size() && mNames[index] != category)
+        index++;
+
+    if (index == mNames.size()) {
+        if (mNames.size() == MaxCategories)
+            return CategoryMask(1) << (MaxCategories - 1);
+
+        mNames.push_back(category);
+        if (isNameEnabled(mNames.back()))
+            mEnabledMask |= CategoryMask(1) << index;
+        publish();
+    }
+
+    return CategoryMask(1) << index;
+};
+
+void CategoryFilter::configure(const char *spec) {
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    mEnabledNames.clear();
+    mDisabledNames.clear();
+    bool hasWildcard = false;
+
+    const std::string text(spec);
+    std::size_t begin = 0;
+    while (begin <= text.size()) {
+        std::size_t end = text.find(',', begin);
+        if (end == std::string::npos)
+            end = text.size();
+
+        std::string name = text.substr(begin, end - begin);
+        begin = end + 1;
+
+        const std::size_t first = name.find_first_not_of(" \t");
+        if (first == std::string::npos)
+            continue;
+        name = name.substr(first, name.find_last_not_of(" \t") - first + 1);
+
+        if (name == "*")
+            hasWildcard = true;
+        else if (name[0] == '-')
+            mDisabledNames.insert(name.substr(1));
+        else
+            mEnabledNames.insert(name);
+    }
+
+    // Naming a category without "-" switches to an allow list
+    mIsEnabledByDefault = hasWildcard || mEnabledNames.empty();
+
+    mEnabledMask = 0;
+    for (std::size_t i = 0; i < mNames.size(); i++) {
+        if (isNameEnabled(mNames[i]))
+            mEnabledMask |= CategoryMask(1) << i;
+    }
+    publish();
+};
+
+void CategoryFilter::setEnabled(const char *category, bool isEnabled) {
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    if (isEnabled) {
+        mDisabledNames.erase(category);
+        mEnabledNames.insert(category);
+    } else {
+        mEnabledNames.erase(category);
+        mDisabledNames.insert(category);
+    }
+
+    for (std::size_t i = 0; i < mNames.size(); i++) {
+        if (mNames[i] != category)
+            continue;
+
+        if (isEnabled)
+            mEnabledMask |= CategoryMask(1) << i;
+        else
+            mEnabledMask &= ~(CategoryMask(1) << i);
+    }
+    publish();
+};
+
+void CategoryFilter::setRecording(bool isRecording) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mIsRecording = isRecording;
+    publish();
+};
+
+bool CategoryFilter::isNameEnabled(const std::string &name) const {
+    if (mDisabledNames.count(name) != 0)
+        return false;
+    return mIsEnabledByDefault || mEnabledNames.count(name) != 0;
+};
+
+// NOTE: Callers hold mMutex
+void CategoryFilter::publish() {
+    mActiveMask.store(mIsRecording ? mEnabledMask : 0,
+                      std::memory_order_relaxed);
+};
+
+} // namespace GTFO
@@ -0,0 +1,59 @@
+#ifndef __GTFO_CATEGORIES_H
+#define __GTFO_CATEGORIES_H
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace GTFO {
+typedef uint64_t CategoryMask;
+
+/**
+ * Runtime on/off switch per event category. Every category name gets one
+ * bit the first time it is seen, call sites cache that bit and test it with
+ * a single relaxed load. The published mask is 0 while no session runs, so
+ * the same test also covers "not profiling at all".
+ *
+ * Specs are comma separated category names, e.g. "render,gpu" records only
+ * those, "-counter,-scope" records everything but those, and "" or "*"
+ * records everything. The GTFO_CATEGORIES environment variable is read as
+ * the initial spec.
+ */
+class CategoryFilter {
+  public:
+    // NOTE: The 64th and every later category share the last bit
+    static const std::size_t MaxCategories = 64;
+
+  private:
+    std::atomic<CategoryMask> mActiveMask{0};
+
+    std::mutex mMutex;
+    std::vector<std::string> mNames; // index is the bit
+    std::set<std::string> mEnabledNames;
+    std::set<std::string> mDisabledNames;
+    bool mIsEnabledByDefault{true};
+    CategoryMask mEnabledMask{0};
+    bool mIsRecording{false};
+
+    bool isNameEnabled(const std::string &name) const;
+    void publish();
+
+  public:
+    CategoryFilter();
+
+    CategoryMask bit(const char *category);
+
+    void configure(const char *spec);
+    void setEnabled(const char *category, bool isEnabled);
+    void setRecording(bool isRecording);
+
+    bool isEnabled(CategoryMask bits) const {
+        return (mActiveMask.load(std::memory_order_relaxed) & bits) != 0;
+    };
+};
+}; // namespace GTFO
+
+#endif // END OF __GTFO_CATEGORIES_H
@@ -0,0 +1,94 @@
+#include "gtfo_clock.h"
+
+#include <thread>
+
+#if defined(GTFO_CLOCK_HAS_TSC) && !defined(_MSC_VER)
+#include <cpuid.h>
+#endif
+
+namespace GTFO {
+
+namespace {
+const uint64_t NanosecondsPerSecond = 1000000000;
+
+// NOTE: Long enough that the steady_clock read jitter is far below 0.1% of
+// the interval, short enough not to be noticed at session start.
+const std::chrono::milliseconds CalibrationInterval(20);
+
+// CPUID 0x80000007 EDX bit 8: the TSC ticks at a constant rate across
+// P-states and keeps running in deep C-states
+bool hasInvariantTSC() {
+#ifdef GTFO_CLOCK_HAS_TSC
+#if defined(_MSC_VER)
+    int registers[4];
+    __cpuid(registers, 0x80000000);
+    if (static_cast<unsigned int>(registers[0]) < 0x80000007)
+        return false;
+    __cpuid(registers, 0x80000007);
+    return (registers[3] & (1 << 8)) != 0;
+#else
+    unsigned int eax, ebx, ecx, edx;
+    if (__get_cpuid_max(0x80000000, nullptr) < 0x80000007)
+        return false;
+    return __get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx) != 0 &&
+           (edx & (1 << 8)) != 0;
+#endif
+#else
+    return false;
+#endif
+};
+
+Clock::Source detectSource() {
+    if (hasInvariantTSC())
+        return Clock::Source::TSC;
+
+#ifdef GTFO_CLOCK_HAS_MONOTONIC_RAW
+    return Clock::Source::MonotonicRaw;
+#else
+    return Clock::Source::Steady;
+#endif
+};
+
+uint64_t steadyNanoseconds() {
+    return static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch())
+            .count());
+};
+} // namespace
+
+const Clock::Source Clock::sSource = detectSource();
+uint64_t Clock::sTicksPerSecond = 0;
+
+const char *Clock::sourceName() {
+    switch (sSource) {
+    case Source::TSC:
+        return "tsc";
+    case Source::MonotonicRaw:
+        return "monotonic_raw";
+    default:
+        return "steady_clock";
+    }
+};
+
+void Clock::calibrate() {
+    if (sTicksPerSecond != 0)
+        return;
+
+    if (sSource != Source::TSC) {
+        sTicksPerSecond = NanosecondsPerSecond;
+        return;
+    }
+
+    const uint64_t startNs = steadyNanoseconds();
+    const uint64_t startTicks = now();
+    std::this_thread::sleep_for(CalibrationInterval);
+    const uint64_t endNs = steadyNanoseconds();
+    const uint64_t endTicks = now();
+
+    sTicksPerSecond = static_cast<uint64_t>(
+        static_cast<double>(endTicks - startTicks) * NanosecondsPerSecond /
+        static_cast<double>(endNs - startNs));
+};
+
+} // namespace GTFO
@@ -0,0 +1,70 @@
+#ifndef __GTFO_CLOCK_H
+#define __GTFO_CLOCK_H
+
+#include <chrono>
+#include <cstdint>
+
+// NOTE: Define GTFO_CLOCK_NO_TSC to never use rdtsc, e.g. on machines where
+// the TSC is known to drift between sockets despite the invariant flag.
+#if !defined(GTFO_CLOCK_NO_TSC) &&                                             \
+    (defined(__x86_64__) || defined(__i386__) || defined(_M_X64))
+#define GTFO_CLOCK_HAS_TSC 1
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+#endif
+
+#if defined(__linux__)
+#define GTFO_CLOCK_HAS_MONOTONIC_RAW 1
+#include <time.h>
+#endif
+
+namespace GTFO {
+/**
+ * Timestamp source for every event. Reads an invariant TSC when the CPU
+ * reports one, otherwise CLOCK_MONOTONIC_RAW, otherwise steady_clock.
+ * Ticks are only meaningful together with ticksPerSecond(), which is
+ * calibrated against steady_clock the first time a session starts.
+ */
+class Clock {
+  public:
+    // NOTE: TSC is last so a zero-initialized source, read by a static
+    // initializer in another translation unit, falls back to the OS clock
+    enum class Source { MonotonicRaw, Steady, TSC };
+
+  private:
+    static const Source sSource;
+    static uint64_t sTicksPerSecond;
+
+  public:
+    static Source source() { return sSource; };
+    static const char *sourceName();
+
+    // Blocks for a few milliseconds on the first call when using the TSC
+    static void calibrate();
+    static uint64_t ticksPerSecond() { return sTicksPerSecond; };
+
+    static uint64_t now() {
+#ifdef GTFO_CLOCK_HAS_TSC
+        if (sSource == Source::TSC)
+            return __rdtsc();
+#endif
+
+#ifdef GTFO_CLOCK_HAS_MONOTONIC_RAW
+        timespec time;
+        clock_gettime(CLOCK_MONOTONIC_RAW, &time);
+        return static_cast<uint64_t>(time.tv_sec) * 1000000000 +
+               static_cast<uint64_t>(time.tv_nsec);
+#else
+        return static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch())
+                .count());
+#endif
+    };
+};
+}; // namespace GTFO
+
+#endif // END OF __GTFO_CLOCK_H
@@ -1,86 +1,428 @@
 #include "gtfo_profiler.h"
 
+#include <cstdio>
+#include <cstring>
+
 namespace GTFO {
 
-Profiler::Profiler() {
-    // HACK: Arbitrary space reservation
-    mJSONData.reserve(1024);
+namespace {
+// NOTE: How often the collector empties the per-thread buffers. A buffer
+// holds EventBuffer::Capacity events, so this only has to outpace a thread
+// emitting a few hundred thousand scopes per second.
+const std::chrono::milliseconds CollectInterval(10);
+
+// NOTE: Trivially destructible, so it can still be read by thread_local
+// destructors that run after tThreadBuffer's
+thread_local bool tIsThreadExiting = false;
+
+// The collector frees the buffer once it has drained what is left
+struct ThreadEventBuffer {
+    EventBuffer *buffer = nullptr;
+
+    ~ThreadEventBuffer() {
+        if (buffer != nullptr)
+            buffer->retire();
+        buffer = nullptr;
+        tIsThreadExiting = true;
+    };
 };
 
+thread_local ThreadEventBuffer tThreadBuffer;
+thread_local ThreadStats *tThreadStats = nullptr;
+
+// Track id of the calling thread, shared by its events, stats and samples
+uint32_t currentThreadId() {
+    return static_cast<uint32_t>(
+        std::hash<std::thread::id>()(std::this_thread::get_id()));
+};
+
+bool endsWith(const char *str, const char *suffix) {
+    const std::size_t length = std::strlen(str);
+    const std::size_t suffixLength = std::strlen(suffix);
+    return length >= suffixLength &&
+           std::strcmp(str + length - suffixLength, suffix) == 0;
+};
+} // namespace
+
+Profiler::Profiler() { mCounterCategory = mCategories.bit("counter"); };
+
 Profiler::~Profiler() {
-    if (mIsActive)
+    if (mIsActive || mIsAggregating)
         endSession();
 };
 
-void Profiler::startSession(const char *name, const char *filePath) {
-    if (mIsActive)
+void Profiler::startSession(const char *name, const char *filePath,
+                            SessionMode mode) {
+    if (mIsActive || mIsAggregating)
         endSession();
 
     mSessionOutputFile = filePath;
     mSessionName = name;
 
-    mJSONFileStream.open(mSessionOutputFile);
-    mIsActive = true;
+    if (mode == SessionMode::Aggregate) {
+        resetStats();
+        Clock::calibrate();
+        mIsAggregating.store(true, std::memory_order_release);
+        mCategories.setRecording(true);
+        return;
+    }
+
+    // Anything recorded between sessions does not belong to this one
+    discardEvents();
+
+    Clock::calibrate();
+    mFrameNumber.store(0, std::memory_order_relaxed);
+    mFrameAllocations.store(0, std::memory_order_relaxed);
+    mSessionStartTicks = Clock::now();
+    if (!mTraceWriter.open(mSessionOutputFile, mSessionStartTicks,
+                           Clock::ticksPerSecond(),
+                           TraceWriter::formatForPath(mSessionOutputFile)) &&
+        mTraceWriter.isLive())
+        std::fprintf(stderr, "[GTFO] No collector listening on %s\n",
+                     mSessionOutputFile);
+
+    // NOTE: Samples are raw addresses that only the converter can
+    // symbolize, JSON traces and live streams would have no use for them
+    if (mSampler.frequency() != 0) {
+        if (TraceWriter::formatForPath(mSessionOutputFile) !=
+                TraceFormat::Binary ||
+            mTraceWriter.isLive())
+            std::fprintf(stderr, "[GTFO] Stack sampling needs a .gtfo "
+                                 "session, %s is not sampled\n",
+                         mSessionOutputFile);
+        else if (mSampler.start() == SamplerBackend::None)
+            std::fprintf(stderr, "[GTFO] Stack sampling is unavailable on "
+                                 "this system\n");
+    }
+
+    mStopCollector = false;
+    mCollectorThread = std::thread(&Profiler::collectorLoop, this);
+    mIsActive.store(true, std::memory_order_release);
+    mCategories.setRecording(true);
 };
 
 void Profiler::endSession() {
+    mCategories.setRecording(false);
+
+    if (mIsAggregating) {
+        mIsAggregating.store(false, std::memory_order_release);
+
+        std::ofstream file(mSessionOutputFile, std::ios::out | std::ios::trunc);
+        writeSummary(file, endsWith(mSessionOutputFile, ".json")
+                               ? SummaryFormat::JSON
+                               : SummaryFormat::Table);
+        return;
+    }
+
     if (!mIsActive)
         return;
 
-    mJSON = mJSONData;
-    mJSONFileStream << mJSON;
-    mJSONFileStream.close();
+    mIsActive.store(false, std::memory_order_release);
+
+    {
+        std::lock_guard<std::mutex> lock(mCollectorMutex);
+        mStopCollector = true;
+    }
+    mCollectorSignal.notify_one();
+    mCollectorThread.join();
+    collectEvents();
+
+    mSampler.stop();
+    collectSamples();
+    if (mSampler.backend() != SamplerBackend::None) {
+        writeModules();
+
+        const uint64_t droppedSamples = mSampler.takeDropped();
+        if (droppedSamples != 0)
+            mTraceWriter.writeMetadata("gtfo_dropped_samples",
+                                       ThreadProcessId, 0, "count",
+                                       droppedSamples);
+    }
 
-    mJSONData.clear();
-    mIsActive = false;
+    std::lock_guard<std::mutex> lock(mBufferMutex);
+    for (const std::unique_ptr<EventBuffer> &buffer : mBuffers) {
+        const uint64_t dropped = buffer->takeDropped();
+        if (dropped != 0)
+            mTraceWriter.writeMetadata("gtfo_dropped_events",
+                                       buffer->processId(), buffer->threadId(),
+                                       "count", dropped);
+    }
+
+    mTraceWriter.close();
 };
 
 void Profiler::writeProfile(const ProfileResult &result) {
-    JSON profile;
+    if (!mIsActive.load(std::memory_order_relaxed))
+        return;
+
+    EventBuffer *buffer = threadBuffer();
+    if (buffer == nullptr)
+        return;
+
+    // Wake the collector early rather than let a busy thread fill up
+    if (buffer->push(result) == EventBuffer::Capacity / 2)
+        mCollectorSignal.notify_one();
+};
+
+void Profiler::writeInstant(const char *name, const char *category) {
+    if (!mIsActive.load(std::memory_order_relaxed))
+        return;
+
+    const uint64_t now = Clock::now();
+    const ProfileResult result = {name, category, now, now,
+                                  EventType::Instant, 0};
+    writeProfile(result);
+};
+
+void Profiler::writeCounter(const char *name, double value) {
+    if (!mIsActive.load(std::memory_order_relaxed))
+        return;
+
+    const ProfileResult result = {name, "counter", Clock::now(),
+                                  counterBits(value), EventType::Counter, 0};
+    writeProfile(result);
+};
+
+void Profiler::markFrame(const char *name) {
+    if (!mIsActive.load(std::memory_order_relaxed))
+        return;
+
+    const uint64_t frame =
+        mFrameNumber.fetch_add(1, std::memory_order_relaxed);
+    const ProfileResult result = {name, "frame", Clock::now(), frame,
+                                  EventType::Frame, 0};
+    writeProfile(result);
+
+    // NOTE: Everything allocated since the previous marker, on any thread
+    if (Allocations::isTracking() && isEnabled(mCounterCategory)) {
+        const uint64_t total = Allocations::total().allocations;
+        const uint64_t previous =
+            mFrameAllocations.exchange(total, std::memory_order_relaxed);
+        if (frame != 0)
+            writeCounter("Frame Allocations",
+                         static_cast<double>(total - previous));
+    }
+};
+
+void Profiler::writeProfile(EventBuffer &track, const ProfileResult &result) {
+    if (!mIsActive.load(std::memory_order_relaxed))
+        return;
 
-    profile["name"] = result.name;
-    profile["cat"] = result.category;
-    profile["ph"] = "X";
-    profile["ts"] = result.start;
-    profile["dur"] = (result.end - result.start);
-    profile["pid"] = 0;
-    profile["tid"] = result.threadId;
+    if (track.push(result) == EventBuffer::Capacity / 2)
+        mCollectorSignal.notify_one();
+};
+
+EventBuffer *Profiler::registerTrack(uint32_t processId, uint32_t threadId,
+                                     const char *processName,
+                                     const char *threadName) {
+    std::lock_guard<std::mutex> lock(mBufferMutex);
+    mBuffers.emplace_back(
+        new EventBuffer(processId, threadId, processName, threadName));
+    return mBuffers.back().get();
+};
+
+// Null once the thread is exiting, events from the remaining thread_local
+// destructors are dropped rather than given a buffer nobody retires
+EventBuffer *Profiler::threadBuffer() {
+    if (tIsThreadExiting)
+        return nullptr;
+
+    if (tThreadBuffer.buffer == nullptr)
+        tThreadBuffer.buffer = registerThread();
+
+    return tThreadBuffer.buffer;
+};
+
+EventBuffer *Profiler::registerThread() {
+    std::lock_guard<std::mutex> lock(mBufferMutex);
+    mBuffers.emplace_back(new EventBuffer(ThreadProcessId, currentThreadId()));
+    return mBuffers.back().get();
+};
+
+ThreadStats &Profiler::threadStats() {
+    if (tThreadStats == nullptr) {
+        std::lock_guard<std::mutex> lock(mStatsMutex);
+        mThreadStats.emplace_back(new ThreadStats(currentThreadId()));
+        tThreadStats = mThreadStats.back().get();
+    }
+
+    return *tThreadStats;
+};
+
+StatsNode *Profiler::enterScope(const char *name) {
+    ThreadStats &stats = threadStats();
+    stats.current = stats.current->child(name);
+    return stats.current;
+};
 
-    mJSONData.emplace_back(profile);
+void Profiler::leaveScope(StatsNode *node, uint64_t durationTicks,
+                          const AllocationTotals &allocations) {
+    node->histogram.record(durationTicks);
+    if (allocations.allocations != 0)
+        node->recordAllocations(allocations.allocations,
+                                allocations.allocatedBytes);
+    threadStats().current = node->parent;
 };
 
-Timer::Timer(const char *name, const char *category) {
-    mStartTimePoint = std::chrono::high_resolution_clock::now();
+void Profiler::writeSummary(std::ostream &out, SummaryFormat format) {
+    SummaryWriter summary(mSessionName, Clock::ticksPerSecond());
 
-    mResult.name = name;
-    mResult.category = category;
-    mResult.start = 0;
-    mResult.end = 0;
-    mResult.threadId = std::hash<std::thread::id>()(std::this_thread::get_id());
+    std::lock_guard<std::mutex> lock(mStatsMutex);
+    for (const std::unique_ptr<ThreadStats> &stats : mThreadStats)
+        summary.addThread(*stats);
 
-    mIsFinished = false;
+    summary.write(out, format);
 };
 
-Timer::~Timer() {
-    if (!mIsFinished)
-        stop();
-}
+namespace {
+void resetNode(StatsNode &node) {
+    node.histogram.reset();
+    node.allocations.store(0, std::memory_order_relaxed);
+    node.allocatedBytes.store(0, std::memory_order_relaxed);
+    for (StatsNode *child = node.firstChild.load(std::memory_order_acquire);
+         child != nullptr; child = child->nextSibling)
+        resetNode(*child);
+};
+} // namespace
+
+void Profiler::resetStats() {
+    std::lock_guard<std::mutex> lock(mStatsMutex);
+    for (const std::unique_ptr<ThreadStats> &stats : mThreadStats)
+        resetNode(stats->root);
+};
+
+const char *Profiler::intern(const std::string &str) {
+    std::lock_guard<std::mutex> lock(mInternMutex);
+    return mInternedStrings.insert(str).first->c_str();
+};
+
+void Profiler::collectorLoop() {
+    std::unique_lock<std::mutex> lock(mCollectorMutex);
+    while (!mStopCollector) {
+        mCollectorSignal.wait_for(lock, CollectInterval);
+        collectEvents();
+        collectSamples();
+        sampleAllocations();
+
+        if (mTraceWriter.isLive())
+            mTraceWriter.flush();
+    }
+};
 
-void Timer::stop() {
-    HighResTimePoint endTimePoint = std::chrono::high_resolution_clock::now();
+void Profiler::collectEvents() {
+    std::lock_guard<std::mutex> lock(mBufferMutex);
+    for (std::size_t i = 0; i < mBuffers.size();) {
+        EventBuffer &buffer = *mBuffers[i];
+        const bool isRetired = buffer.isRetired();
+        if (!buffer.isNamed())
+            writeNames(buffer);
 
-    mResult.start =
-        std::chrono::time_point_cast<std::chrono::microseconds>(mStartTimePoint)
-            .time_since_epoch()
-            .count();
+        const uint32_t processId = buffer.processId();
+        const uint32_t threadId = buffer.threadId();
+        buffer.drain(
+            [this, processId, threadId](const ProfileResult &result) {
+                mTraceWriter.writeEvent(result, processId, threadId);
+            });
+
+        if (!isRetired) {
+            i++;
+            continue;
+        }
+
+        // NOTE: endSession() never sees this buffer again
+        const uint64_t dropped = buffer.takeDropped();
+        if (dropped != 0)
+            mTraceWriter.writeMetadata("gtfo_dropped_events", processId,
+                                       threadId, "count", dropped);
+        mBuffers.erase(mBuffers.begin() + i);
+    }
+};
+
+// NOTE: Written ahead of a track's first events rather than at the end of
+// the session, so a live collector can label a window it dumps early. The
+// writer repeats them after a Reset on its own.
+void Profiler::writeNames(EventBuffer &buffer) {
+    if (buffer.processName() != nullptr)
+        mTraceWriter.writeName("process_name", buffer.processId(),
+                               buffer.threadId(), buffer.processName());
+    if (buffer.threadName() != nullptr)
+        mTraceWriter.writeName("thread_name", buffer.processId(),
+                               buffer.threadId(), buffer.threadName());
+    buffer.setNamed(true);
+};
+
+void Profiler::sampleThisThread() {
+    mSampler.registerThread(currentThreadId());
+};
+
+void Profiler::collectSamples() {
+    mSamples.clear();
+    if (mSampler.drain(mSamples) == 0)
+        return;
+
+    for (std::size_t i = 0; i < mSamples.size(); i++)
+        mTraceWriter.writeSample(mSamples[i], ThreadProcessId);
+};
+
+// NOTE: Every executable mapping at the end of the session, a library
+// unloaded halfway through leaves its samples unsymbolized
+void Profiler::writeModules() {
+#if defined(__linux__)
+    std::FILE *maps = std::fopen("/proc/self/maps", "r");
+    if (maps == nullptr)
+        return;
+
+    char line[4096];
+    while (std::fgets(line, sizeof(line), maps) != nullptr) {
+        unsigned long long start, end, offset;
+        char permissions[8];
+        char path[4096];
+        path[0] = '\0';
+        if (std::sscanf(line, "%llx-%llx %7s %llx %*s %*s %4095[^\n]", &start,
+                        &end, permissions, &offset, path) < 4)
+            continue;
+        if (permissions[2] != 'x' || path[0] != '/')
+            continue;
+
+        mTraceWriter.writeModule(intern(path), start, end, offset);
+    }
+    std::fclose(maps);
+#endif
+};
+
+// NOTE: Process-wide heap counters, written straight to the trace from the
+// collector on a track of their own
+void Profiler::sampleAllocations() {
+    if (!Allocations::isTracking() || !isEnabled(mCounterCategory))
+        return;
+
+    const AllocationTotals totals = Allocations::total();
+    ProfileResult result = {"Heap Allocations", "counter", Clock::now(),
+                            counterBits(static_cast<double>(
+                                totals.allocations)),
+                            EventType::Counter, 0};
+    mTraceWriter.writeEvent(result, ThreadProcessId, 0);
+
+    if (Allocations::mode() == AllocationMode::Full) {
+        result.name = "Heap Live Bytes";
+        result.end = counterBits(static_cast<double>(totals.liveBytes()));
+        mTraceWriter.writeEvent(result, ThreadProcessId, 0);
+    }
+};
 
-    mResult.end =
-        std::chrono::time_point_cast<std::chrono::microseconds>(endTimePoint)
-            .time_since_epoch()
-            .count();
+void Profiler::discardEvents() {
+    std::lock_guard<std::mutex> lock(mBufferMutex);
+    for (std::size_t i = 0; i < mBuffers.size();) {
+        if (mBuffers[i]->isRetired()) {
+            mBuffers.erase(mBuffers.begin() + i);
+            continue;
+        }
 
-    Profiler::get().writeProfile(mResult);
-    mIsFinished = true;
+        mBuffers[i]->drain([](const ProfileResult &) {});
+        mBuffers[i]->takeDropped();
+        mBuffers[i]->setNamed(false);
+        i++;
+    }
 };
 
 } // namespace GTFO
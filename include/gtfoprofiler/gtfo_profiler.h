@@ -18,91 +18,408 @@
 #define GTFO_TIMESCALE "ns"
 #endif
 
-#ifndef __GTFO_JSON
-#define __GTFO_JSON
-#include "include/nlohmann/json.hpp"
-#endif
+#include "gtfo_allocations.h"
+#include "gtfo_categories.h"
+#include "gtfo_clock.h"
+#include "gtfo_sampler.h"
+#include "gtfo_stats.h"
+#include "gtfo_trace_writer.h"
 
+#include <algorithm>
+#include <atomic>
 #include <chrono>
-#include <fstream>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
 #include <functional>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
 #include <thread>
 #include <vector>
 
 namespace GTFO {
+enum class EventType : uint8_t {
+    Complete, // "X", a scope from start to end
+    Instant,  // "i", a point in time on one thread
+    Counter,  // "C", a sampled value
+    Frame,    // global "i" marking a frame boundary
+};
+
+/**
+ * Fixed-size POD trace record. Name and category must outlive the session,
+ * string literals and __FUNCTION__ do, anything else goes through
+ * Profiler::intern(). Timestamps are raw Clock ticks, they are only
+ * converted when the trace is written.
+ */
 struct ProfileResult {
     const char *name;
     const char *category;
-    uint32_t threadId;
-    long long start;
-    long long end;
+    uint64_t start;
+    uint64_t end; // Counter: bits of the value, Frame: the frame number
+    EventType type;
+    uint32_t allocations; // Complete: heap allocations inside the scope
+};
+
+inline uint64_t counterBits(double value) {
+    uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return bits;
+};
+
+inline double counterValue(const ProfileResult &result) {
+    double value;
+    std::memcpy(&value, &result.end, sizeof(value));
+    return value;
+};
+
+// Process id of every thread track, other tracks pick their own
+const uint32_t ThreadProcessId = 0;
+
+enum class SessionMode {
+    Trace,     // every scope is streamed to the session file
+    Aggregate, // per-scope statistics only, summarized at endSession()
 };
 
 struct ProfileSession {
     const char *name;
 };
 
-using HighResTimePoint =
-    std::chrono::time_point<std::chrono::high_resolution_clock>;
+/**
+ * Fixed-capacity single-producer/single-consumer ring owned by one thread.
+ * The owning thread pushes with a couple of relaxed loads and one release
+ * store, the profiler's collector is the only consumer.
+ */
+class EventBuffer {
+  public:
+    static const std::size_t Capacity = 1 << 14;
+
+  private:
+    // NOTE: Padding keeps the producer and consumer indices on separate cache
+    // lines without relying on C++17 over-aligned new.
+    std::atomic<std::size_t> mHead{0};
+    char mHeadPadding[64 - sizeof(std::atomic<std::size_t>)];
+    std::atomic<std::size_t> mTail{0};
+    char mTailPadding[64 - sizeof(std::atomic<std::size_t>)];
+    std::atomic<uint64_t> mDropped{0};
+    std::atomic<bool> mIsRetired{false};
+    uint32_t mProcessId;
+    uint32_t mThreadId;
+    const char *mProcessName;
+    const char *mThreadName;
+    bool mIsNamed{false}; // names written this session, collector only
+    ProfileResult mEvents[Capacity];
 
-using JSON = nlohmann::json;
+  public:
+    EventBuffer(uint32_t processId, uint32_t threadId,
+                const char *processName = nullptr,
+                const char *threadName = nullptr)
+        : mProcessId(processId), mThreadId(threadId),
+          mProcessName(processName), mThreadName(threadName){};
+
+    uint32_t processId() const { return mProcessId; };
+    uint32_t threadId() const { return mThreadId; };
+    const char *processName() const { return mProcessName; };
+    const char *threadName() const { return mThreadName; };
+    bool isNamed() const { return mIsNamed; };
+    void setNamed(bool isNamed) { mIsNamed = isNamed; };
+
+    // Set by the owning thread as it exits, the collector frees the buffer
+    // once it has drained what is left
+    void retire() { mIsRetired.store(true, std::memory_order_release); };
+    bool isRetired() const {
+        return mIsRetired.load(std::memory_order_acquire);
+    };
+
+    // Returns the number of pending events, 0 if the event was dropped
+    std::size_t push(const ProfileResult &result) {
+        const std::size_t head = mHead.load(std::memory_order_relaxed);
+        const std::size_t pending =
+            head - mTail.load(std::memory_order_acquire);
+        if (pending == Capacity) {
+            mDropped.fetch_add(1, std::memory_order_relaxed);
+            return 0;
+        }
+
+        mEvents[head & (Capacity - 1)] = result;
+        mHead.store(head + 1, std::memory_order_release);
+        return pending + 1;
+    };
+
+    template <typename Consumer> std::size_t drain(Consumer &&consume) {
+        const std::size_t tail = mTail.load(std::memory_order_relaxed);
+        const std::size_t head = mHead.load(std::memory_order_acquire);
+
+        for (std::size_t i = tail; i != head; i++)
+            consume(mEvents[i & (Capacity - 1)]);
+
+        mTail.store(head, std::memory_order_release);
+        return head - tail;
+    };
+
+    uint64_t takeDropped() {
+        return mDropped.exchange(0, std::memory_order_relaxed);
+    };
+};
 
 class Profiler {
   private:
-    bool mIsActive;
+    std::atomic<bool> mIsActive{false};
+    std::atomic<uint64_t> mFrameNumber{0};
+    std::atomic<uint64_t> mFrameAllocations{0};
+    CategoryMask mCounterCategory{0};
 
     ProfileSession *mCurrentSession{nullptr};
     const char *mSessionOutputFile{"NULL"};
     const char *mSessionName{"NULL"};
 
-    JSON mJSON;
-    std::vector<JSON> mJSONData;
-    std::ofstream mJSONFileStream;
+    TraceWriter mTraceWriter;
+    uint64_t mSessionStartTicks{0};
+
+    std::mutex mInternMutex;
+    std::set<std::string> mInternedStrings;
+
+    // NOTE: A thread that exits retires its buffer rather than freeing it,
+    // so events it recorded late are still collected before it goes.
+    std::mutex mBufferMutex;
+    std::vector<std::unique_ptr<EventBuffer>> mBuffers;
+
+    std::mutex mCollectorMutex;
+    std::condition_variable mCollectorSignal;
+    std::thread mCollectorThread;
+    bool mStopCollector{false};
+
+    // NOTE: Like the event buffers, per-thread statistics are kept for the
+    // lifetime of the profiler and only reset when an aggregate session
+    // starts.
+    std::atomic<bool> mIsAggregating{false};
+    std::mutex mStatsMutex;
+    std::vector<std::unique_ptr<ThreadStats>> mThreadStats;
+
+    CategoryFilter mCategories;
+
+    // NOTE: Only touched by the collector and endSession()
+    Sampler mSampler;
+    std::vector<StackSample> mSamples;
 
     Profiler();
     ~Profiler();
 
+    EventBuffer *registerThread();
+    EventBuffer *threadBuffer();
+    ThreadStats &threadStats();
+    void resetStats();
+
+    void collectorLoop();
+    void collectEvents();
+    void writeNames(EventBuffer &buffer);
+    void collectSamples();
+    void writeModules();
+    void sampleAllocations();
+    void discardEvents();
+
   public:
     static Profiler &get() {
         static Profiler instance;
         return instance;
     };
 
+    // In Aggregate mode filePath receives the summary, as JSON when it ends
+    // in ".json" and as a table otherwise
     void startSession(const char *name,
-                      const char *filePath = "sessionResults.json");
+                      const char *filePath = "sessionResults.json",
+                      SessionMode mode = SessionMode::Trace);
 
     void endSession();
     void writeProfile(const ProfileResult &result);
+
+    void writeInstant(const char *name, const char *category);
+    void writeCounter(const char *name, double value);
+    void markFrame(const char *name);
+
+    // A track for events that are not timed by the calling thread, such as
+    // GPU queue timestamps. Names must outlive the profiler and only one
+    // thread at a time may write to a track.
+    EventBuffer *registerTrack(uint32_t processId, uint32_t threadId,
+                               const char *processName,
+                               const char *threadName);
+    void writeProfile(EventBuffer &track, const ProfileResult &result);
+
+    bool isAggregating() const {
+        return mIsAggregating.load(std::memory_order_relaxed);
+    };
+
+    // Bit for a category name, stable for the lifetime of the profiler.
+    // Takes a lock, the macros look it up once per call site.
+    CategoryMask categoryBit(const char *category) {
+        return mCategories.bit(category);
+    };
+
+    // False while no session runs or when every category in bits is off
+    bool isEnabled(CategoryMask bits) const {
+        return mCategories.isEnabled(bits);
+    };
+
+    // Same syntax as the GTFO_CATEGORIES environment variable, replaces
+    // whatever was configured before
+    void setCategories(const char *spec) { mCategories.configure(spec); };
+    void setCategoryEnabled(const char *category, bool isEnabled) {
+        mCategories.setEnabled(category, isEnabled);
+    };
+
+    // Stack samples per second of CPU time for threads that called
+    // sampleThisThread(), 0 turns sampling off. Takes effect when the next
+    // .gtfo trace session starts.
+    void setSamplingFrequency(uint32_t frequency) {
+        mSampler.setFrequency(frequency);
+    };
+    void sampleThisThread();
+
+    // Aggregate mode: move the calling thread into (out of) a scope
+    StatsNode *enterScope(const char *name);
+    void leaveScope(StatsNode *node, uint64_t durationTicks,
+                    const AllocationTotals &allocations);
+
+    // Summary of everything aggregated so far, safe to call at any time
+    void writeSummary(std::ostream &out, SummaryFormat format);
+
+    // Returns a pointer that stays valid for the lifetime of the profiler
+    const char *intern(const std::string &str);
 };
 
 class Timer {
   private:
-    HighResTimePoint mStartTimePoint;
     ProfileResult mResult;
+    StatsNode *mStatsNode;
     bool mIsFinished;
+    bool mIsTrackingAllocations;
+    AllocationTotals mAllocationsAtStart;
 
   public:
-    explicit Timer(const char *name, const char *category = "function");
-    ~Timer();
+    // NOTE: A disabled category returns before the clock is read, the
+    // destructor then only tests mIsFinished
+    Timer(const char *name, const char *category, CategoryMask categoryBit) {
+        Profiler &profiler = Profiler::get();
+        mIsFinished = !profiler.isEnabled(categoryBit);
+        if (mIsFinished)
+            return;
+
+        mResult.name = name;
+        mResult.category = category;
+        mResult.end = 0;
+        mResult.type = EventType::Complete;
+        mResult.allocations = 0;
+
+        mStatsNode =
+            profiler.isAggregating() ? profiler.enterScope(name) : nullptr;
+
+        // NOTE: Compiles away unless GTFO_TRACK_ALLOCATIONS is defined
+        mIsTrackingAllocations = Allocations::isTracking();
+        if (mIsTrackingAllocations)
+            mAllocationsAtStart = Allocations::thread();
+        mResult.start = Clock::now();
+    };
+
+    explicit Timer(const char *name, const char *category = "function")
+        : Timer(name, category, Profiler::get().categoryBit(category)){};
+
+    ~Timer() {
+        if (!mIsFinished)
+            stop();
+    };
 
-    void stop();
+    void stop() {
+        if (mIsFinished)
+            return;
+
+        mResult.end = Clock::now();
+
+        AllocationTotals allocations;
+        if (mIsTrackingAllocations) {
+            const AllocationTotals now = Allocations::thread();
+            allocations.allocations =
+                now.allocations - mAllocationsAtStart.allocations;
+            allocations.allocatedBytes =
+                now.allocatedBytes - mAllocationsAtStart.allocatedBytes;
+            mResult.allocations = static_cast<uint32_t>(
+                std::min<uint64_t>(allocations.allocations, UINT32_MAX));
+        }
+
+        if (mStatsNode != nullptr)
+            Profiler::get().leaveScope(
+                mStatsNode, mResult.end - mResult.start, allocations);
+        else
+            Profiler::get().writeProfile(mResult);
+        mIsFinished = true;
+    };
 };
 }; // namespace GTFO
 
+#define GTFO_CONCAT_IMPL(a, b) a##b
+#define GTFO_CONCAT(a, b) GTFO_CONCAT_IMPL(a, b)
+
+// NOTE: __COUNTER__ is not standard C++11 but every supported compiler has
+// it, it keeps two scopes on one line from declaring the same name
+#ifdef __COUNTER__
+#define GTFO_UNIQUE(prefix) GTFO_CONCAT(prefix, __COUNTER__)
+#else
+#define GTFO_UNIQUE(prefix) GTFO_CONCAT(prefix, __LINE__)
+#endif
+
 #ifndef GTFO_PROFILER_OFF
+// NOTE: Categories are looked up once per call site and must be the same
+// every time the site runs, in practice a string literal
+#define GTFO_CATEGORY_BIT(id, category)                                        \
+    static const GTFO::CategoryMask GTFO_CONCAT(id, Category) =                \
+        GTFO::Profiler::get().categoryBit(category)
+#define GTFO_SCOPE_IMPL(id, scopeName, scopeCategory)                          \
+    GTFO_CATEGORY_BIT(id, scopeCategory);                                      \
+    GTFO::Timer GTFO_CONCAT(id, Timer)(scopeName, scopeCategory,               \
+                                       GTFO_CONCAT(id, Category))
+#define GTFO_IF_ENABLED_IMPL(id, category)                                     \
+    GTFO_CATEGORY_BIT(id, category);                                           \
+    if (GTFO::Profiler::get().isEnabled(GTFO_CONCAT(id, Category)))
+#define GTFO_IF_ENABLED(category)                                              \
+    GTFO_IF_ENABLED_IMPL(GTFO_UNIQUE(gtfo), category)
+
 #define GTFO_PROFILE_SESSION_START(name, filePath)                             \
     GTFO::Profiler::get().startSession(name, filePath);
+#define GTFO_PROFILE_AGGREGATE_START(name, filePath)                           \
+    GTFO::Profiler::get().startSession(name, filePath,                         \
+                                       GTFO::SessionMode::Aggregate);
 #define GTFO_PROFILE_SESSION_END() GTFO::Profiler::get().endSession();
 #define GTFO_PROFILE_SCOPE(scopeName, scopeCategory)                           \
-    GTFO::Timer timer##__LINE__(scopeName, scopeCategory)
+    GTFO_SCOPE_IMPL(GTFO_UNIQUE(gtfo), scopeName, scopeCategory)
 #define GTFO_PROFILE_FUNCTION() GTFO_PROFILE_SCOPE(__FUNCTION__, "function")
+#define GTFO_PROFILE_INSTANT(name, category)                                   \
+    do {                                                                       \
+        GTFO_IF_ENABLED(category)                                              \
+        GTFO::Profiler::get().writeInstant(name, category);                    \
+    } while (0)
+#define GTFO_PROFILE_COUNTER(name, value)                                      \
+    do {                                                                       \
+        GTFO_IF_ENABLED("counter")                                             \
+        GTFO::Profiler::get().writeCounter(name, static_cast<double>(value));  \
+    } while (0)
+#define GTFO_PROFILE_FRAME(name)                                               \
+    do {                                                                       \
+        GTFO_IF_ENABLED("frame")                                               \
+        GTFO::Profiler::get().markFrame(name);                                 \
+    } while (0)
+#define GTFO_PROFILE_SAMPLE_THREAD() GTFO::Profiler::get().sampleThisThread()
 #endif
 
 #ifdef GTFO_PROFILER_OFF
 #define GTFO_PROFILE_SESSION_START(name, filePath)
+#define GTFO_PROFILE_AGGREGATE_START(name, filePath)
 #define GTFO_PROFILE_SESSION_END()
 #define GTFO_PROFILE_SCOPE(scopeName, scopeCategory)
 #define GTFO_PROFILE_FUNCTION() GTFO_PROFILE_SCOPE(__FUNCTION__, "function")
+#define GTFO_PROFILE_INSTANT(name, category)
+#define GTFO_PROFILE_COUNTER(name, value)
+#define GTFO_PROFILE_FRAME(name)
+#define GTFO_PROFILE_SAMPLE_THREAD()
 #endif
 
 #endif // END OF __GTFO_PROFILER_H
@@ -0,0 +1,487 @@
+#include "gtfo_sampler.h"
+#include "gtfo_clock.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+#if defined(__linux__)
+#include <errno.h>
+#include <execinfo.h>
+#include <linux/perf_event.h>
+#include <pthread.h>
+#include <signal.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <ucontext.h>
+#include <unistd.h>
+
+#ifndef sigev_notify_thread_id
+#define sigev_notify_thread_id _sigev_un._tid
+#endif
+#endif
+
+namespace GTFO {
+
+#if defined(__linux__)
+
+namespace {
+// NOTE: 2^n data pages per perf ring, 64 pages hold ~500 deep stacks which
+// is several collector intervals at 1 kHz
+const std::size_t PerfRingPages = 64;
+
+// Ring the SIGPROF handler fills on its own thread, drained by the
+// collector. Lock-free atomics only, the handler may interrupt anything.
+class SignalRing {
+  public:
+    static const std::size_t Capacity = 256;
+
+  private:
+    std::atomic<std::size_t> mHead{0};
+    std::atomic<std::size_t> mTail{0};
+    std::atomic<uint64_t> mDropped{0};
+    StackSample mSamples[Capacity];
+
+  public:
+    StackSample *reserve() {
+        const std::size_t head = mHead.load(std::memory_order_relaxed);
+        if (head - mTail.load(std::memory_order_acquire) == Capacity) {
+            mDropped.fetch_add(1, std::memory_order_relaxed);
+            return nullptr;
+        }
+        return &mSamples[head & (Capacity - 1)];
+    };
+
+    void commit() {
+        mHead.store(mHead.load(std::memory_order_relaxed) + 1,
+                    std::memory_order_release);
+    };
+
+    std::size_t drain(std::vector<StackSample> &samples) {
+        const std::size_t tail = mTail.load(std::memory_order_relaxed);
+        const std::size_t head = mHead.load(std::memory_order_acquire);
+        for (std::size_t i = tail; i != head; i++)
+            samples.push_back(mSamples[i & (Capacity - 1)]);
+        mTail.store(head, std::memory_order_release);
+        return head - tail;
+    };
+
+    uint64_t takeDropped() {
+        return mDropped.exchange(0, std::memory_order_relaxed);
+    };
+};
+
+uint64_t monotonicRawNanoseconds() {
+    timespec time;
+    clock_gettime(CLOCK_MONOTONIC_RAW, &time);
+    return static_cast<uint64_t>(time.tv_sec) * 1000000000ull +
+           static_cast<uint64_t>(time.tv_nsec);
+};
+
+uintptr_t interruptedPC(void *context) {
+    const ucontext_t *ucontext = static_cast<const ucontext_t *>(context);
+#if defined(__x86_64__)
+    return static_cast<uintptr_t>(ucontext->uc_mcontext.gregs[REG_RIP]);
+#elif defined(__i386__)
+    return static_cast<uintptr_t>(ucontext->uc_mcontext.gregs[REG_EIP]);
+#elif defined(__aarch64__)
+    return static_cast<uintptr_t>(ucontext->uc_mcontext.pc);
+#else
+    (void)ucontext;
+    return 0;
+#endif
+};
+
+void copyFromRing(void *destination, const char *data, std::size_t dataSize,
+                  uint64_t position, std::size_t size) {
+    const std::size_t offset = static_cast<std::size_t>(position % dataSize);
+    const std::size_t first = std::min(size, dataSize - offset);
+    std::memcpy(destination, data + offset, first);
+    std::memcpy(static_cast<char *>(destination) + first, data, size - first);
+};
+} // namespace
+
+struct Sampler::SampledThread {
+    uint32_t threadId;
+    pid_t systemThreadId;
+    pthread_t handle;
+    bool isRetired{false};
+
+    int perfFd{-1};
+    void *perfRing{nullptr};
+    std::size_t perfRingSize{0};
+
+    timer_t timer;
+    bool hasTimer{false};
+    std::atomic<bool> isSignalSampling{false};
+    SignalRing signalRing;
+};
+
+namespace {
+// NOTE: Set on the sampled thread itself, so its TLS block exists before
+// the first signal arrives
+thread_local Sampler::SampledThread *tSampledThread = nullptr;
+
+struct ThreadRetirer {
+    Sampler *sampler{nullptr};
+    ~ThreadRetirer() {
+        if (sampler != nullptr && tSampledThread != nullptr)
+            sampler->retireThread(*tSampledThread);
+    };
+};
+thread_local ThreadRetirer tRetirer;
+
+void handleProfilingSignal(int, siginfo_t *, void *context) {
+    Sampler::SampledThread *thread = tSampledThread;
+    if (thread == nullptr ||
+        !thread->isSignalSampling.load(std::memory_order_relaxed))
+        return;
+
+    const int savedErrno = errno;
+    StackSample *sample = thread->signalRing.reserve();
+    if (sample != nullptr) {
+        // NOTE: The first frames belong to this handler and the signal
+        // trampoline, the stack proper starts at the interrupted pc
+        void *frames[MaxStackDepth + 4];
+        const int depth = backtrace(frames, MaxStackDepth + 4);
+        const uintptr_t pc = interruptedPC(context);
+
+        int first = (depth > 2) ? 2 : depth;
+        for (int i = 0; i < depth && i < 4; i++) {
+            if (reinterpret_cast<uintptr_t>(frames[i]) == pc) {
+                first = i;
+                break;
+            }
+        }
+
+        sample->threadId = thread->threadId;
+        sample->ticks = Clock::now();
+        sample->depth = 0;
+        for (int i = first; i < depth && sample->depth < MaxStackDepth; i++)
+            sample->frames[sample->depth++] =
+                reinterpret_cast<uintptr_t>(frames[i]);
+        thread->signalRing.commit();
+    }
+    errno = savedErrno;
+};
+
+bool installSignalHandler() {
+    static bool sIsInstalled = false;
+    if (sIsInstalled)
+        return true;
+
+    struct sigaction previous;
+    if (sigaction(SIGPROF, nullptr, &previous) != 0)
+        return false;
+    // Leave SIGPROF alone if someone else already handles it
+    if ((previous.sa_flags & SA_SIGINFO) != 0 ||
+        (previous.sa_handler != SIG_DFL && previous.sa_handler != SIG_IGN))
+        return false;
+
+    // NOTE: backtrace() loads libgcc on first use, which must not happen
+    // inside the handler
+    void *warmUp[1];
+    backtrace(warmUp, 1);
+
+    struct sigaction action;
+    std::memset(&action, 0, sizeof(action));
+    action.sa_sigaction = handleProfilingSignal;
+    action.sa_flags = SA_SIGINFO | SA_RESTART;
+    sigemptyset(&action.sa_mask);
+    sIsInstalled = (sigaction(SIGPROF, &action, nullptr) == 0);
+    return sIsInstalled;
+};
+} // namespace
+
+Sampler::Sampler() {
+    const char *frequency = std::getenv("GTFO_SAMPLE_HZ");
+    if (frequency != nullptr)
+        mFrequency =
+            static_cast<uint32_t>(std::strtoul(frequency, nullptr, 10));
+
+    const char *backend = std::getenv("GTFO_SAMPLER");
+    mIsSignalForced =
+        (backend != nullptr && std::strcmp(backend, "signal") == 0);
+};
+
+Sampler::~Sampler() {
+    std::lock_guard<std::mutex> lock(mMutex);
+    for (std::size_t i = 0; i < mThreads.size(); i++) {
+        stopThread(*mThreads[i]);
+        releaseThread(*mThreads[i]);
+    }
+};
+
+void Sampler::registerThread(uint32_t threadId) {
+    if (tSampledThread != nullptr)
+        return;
+
+    std::lock_guard<std::mutex> lock(mMutex);
+    mThreads.emplace_back(new SampledThread());
+    SampledThread &thread = *mThreads.back();
+    thread.threadId = threadId;
+    thread.systemThreadId = static_cast<pid_t>(syscall(SYS_gettid));
+    thread.handle = pthread_self();
+
+    tSampledThread = &thread;
+    tRetirer.sampler = this;
+
+    if (mIsRunning)
+        startWithFallback(thread);
+};
+
+void Sampler::retireThread(SampledThread &thread) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    stopThread(thread);
+    thread.isRetired = true;
+    tSampledThread = nullptr;
+};
+
+SamplerBackend Sampler::start() {
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (mIsRunning || mFrequency == 0)
+        return mBackend;
+
+    mAnchorTicks = Clock::now();
+    mAnchorNanoseconds = monotonicRawNanoseconds();
+    mTicksPerNanosecond = static_cast<double>(Clock::ticksPerSecond()) / 1e9;
+    mDropped = 0;
+
+    mBackend = mIsSignalForced ? SamplerBackend::Signal
+                               : SamplerBackend::PerfEvent;
+    if (mBackend == SamplerBackend::Signal && !installSignalHandler()) {
+        mBackend = SamplerBackend::None;
+        return mBackend;
+    }
+
+    mIsRunning = true;
+    for (std::size_t i = 0; i < mThreads.size(); i++) {
+        releaseThread(*mThreads[i]);
+        if (!mThreads[i]->isRetired)
+            startWithFallback(*mThreads[i]);
+    }
+    return mBackend;
+};
+
+// NOTE: perf_event_open fails for every thread once it fails for one
+// (paranoid level, seccomp, missing syscall), from then on the session
+// uses signals
+bool Sampler::startWithFallback(SampledThread &thread) {
+    if (startThread(thread))
+        return true;
+    if (mBackend != SamplerBackend::PerfEvent || !installSignalHandler())
+        return false;
+
+    mBackend = SamplerBackend::Signal;
+    return startThread(thread);
+};
+
+void Sampler::stop() {
+    std::lock_guard<std::mutex> lock(mMutex);
+    for (std::size_t i = 0; i < mThreads.size(); i++)
+        stopThread(*mThreads[i]);
+    mIsRunning = false;
+};
+
+bool Sampler::startThread(SampledThread &thread) {
+    if (mBackend == SamplerBackend::PerfEvent) {
+        perf_event_attr attributes;
+        std::memset(&attributes, 0, sizeof(attributes));
+        attributes.size = sizeof(attributes);
+        attributes.type = PERF_TYPE_SOFTWARE;
+        attributes.config = PERF_COUNT_SW_TASK_CLOCK;
+        attributes.freq = 1;
+        attributes.sample_freq = mFrequency;
+        attributes.sample_type =
+            PERF_SAMPLE_TID | PERF_SAMPLE_TIME | PERF_SAMPLE_CALLCHAIN;
+        attributes.exclude_kernel = 1;
+        attributes.exclude_hv = 1;
+        attributes.exclude_callchain_kernel = 1;
+        attributes.use_clockid = 1;
+        attributes.clockid = CLOCK_MONOTONIC_RAW;
+        attributes.disabled = 1;
+
+        const int fd = static_cast<int>(
+            syscall(SYS_perf_event_open, &attributes, thread.systemThreadId,
+                    -1, -1, PERF_FLAG_FD_CLOEXEC));
+        if (fd < 0)
+            return false;
+
+        const std::size_t pageSize =
+            static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+        const std::size_t size = (PerfRingPages + 1) * pageSize;
+        void *ring =
+            mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (ring == MAP_FAILED) {
+            close(fd);
+            return false;
+        }
+
+        thread.perfFd = fd;
+        thread.perfRing = ring;
+        thread.perfRingSize = size;
+        return ioctl(fd, PERF_EVENT_IOC_ENABLE, 0) == 0;
+    }
+
+    clockid_t clock;
+    if (pthread_getcpuclockid(thread.handle, &clock) != 0)
+        return false;
+
+    sigevent event;
+    std::memset(&event, 0, sizeof(event));
+    event.sigev_notify = SIGEV_THREAD_ID;
+    event.sigev_signo = SIGPROF;
+    event.sigev_notify_thread_id = thread.systemThreadId;
+    if (timer_create(clock, &event, &thread.timer) != 0)
+        return false;
+    thread.hasTimer = true;
+    thread.isSignalSampling.store(true, std::memory_order_relaxed);
+
+    const long interval = static_cast<long>(1000000000ull / mFrequency);
+    itimerspec spec;
+    spec.it_interval.tv_sec = interval / 1000000000L;
+    spec.it_interval.tv_nsec = interval % 1000000000L;
+    spec.it_value = spec.it_interval;
+    return timer_settime(thread.timer, 0, &spec, nullptr) == 0;
+};
+
+// NOTE: Keeps the perf ring mapped so samples taken before the stop can
+// still be drained, releaseThread() frees it
+void Sampler::stopThread(SampledThread &thread) {
+    if (thread.perfFd >= 0)
+        ioctl(thread.perfFd, PERF_EVENT_IOC_DISABLE, 0);
+
+    thread.isSignalSampling.store(false, std::memory_order_relaxed);
+    if (thread.hasTimer) {
+        timer_delete(thread.timer);
+        thread.hasTimer = false;
+    }
+};
+
+void Sampler::releaseThread(SampledThread &thread) {
+    if (thread.perfRing != nullptr)
+        munmap(thread.perfRing, thread.perfRingSize);
+    if (thread.perfFd >= 0)
+        close(thread.perfFd);
+
+    thread.perfRing = nullptr;
+    thread.perfRingSize = 0;
+    thread.perfFd = -1;
+};
+
+uint64_t Sampler::toTicks(uint64_t nanoseconds) const {
+    const double delta = static_cast<double>(
+        static_cast<int64_t>(nanoseconds - mAnchorNanoseconds));
+    return mAnchorTicks + static_cast<int64_t>(delta * mTicksPerNanosecond);
+};
+
+std::size_t Sampler::drain(std::vector<StackSample> &samples) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    const std::size_t before = samples.size();
+
+    for (std::size_t i = 0; i < mThreads.size(); i++) {
+        SampledThread &thread = *mThreads[i];
+        mDropped += thread.signalRing.takeDropped();
+        thread.signalRing.drain(samples);
+
+        if (thread.perfRing == nullptr)
+            continue;
+
+        perf_event_mmap_page *page =
+            static_cast<perf_event_mmap_page *>(thread.perfRing);
+        const std::size_t pageSize =
+            thread.perfRingSize / (PerfRingPages + 1);
+        const char *data =
+            static_cast<const char *>(thread.perfRing) + pageSize;
+        const std::size_t dataSize = thread.perfRingSize - pageSize;
+
+        const uint64_t head =
+            __atomic_load_n(&page->data_head, __ATOMIC_ACQUIRE);
+        uint64_t tail = page->data_tail;
+
+        std::vector<uint64_t> record;
+        while (tail < head) {
+            perf_event_header header;
+            copyFromRing(&header, data, dataSize, tail, sizeof(header));
+            if (header.size < sizeof(header))
+                break;
+
+            record.resize((header.size + 7) / 8);
+            copyFromRing(record.data(), data, dataSize, tail, header.size);
+            tail += header.size;
+
+            // NOTE: Sample layout for TID | TIME | CALLCHAIN is header,
+            // pid/tid, time, nr, ips[nr]. The callchain opens with a
+            // PERF_CONTEXT_USER marker before the interrupted pc.
+            if (header.type == PERF_RECORD_LOST && record.size() >= 3) {
+                mDropped += record[2];
+            } else if (header.type == PERF_RECORD_SAMPLE &&
+                       record.size() >= 4) {
+                const uint64_t count =
+                    std::min<uint64_t>(record[3], record.size() - 4);
+
+                StackSample sample;
+                sample.threadId = thread.threadId;
+                sample.ticks = toTicks(record[2]);
+                sample.depth = 0;
+                for (uint64_t j = 0; j < count; j++) {
+                    const uint64_t address = record[4 + j];
+                    if (address >= static_cast<uint64_t>(PERF_CONTEXT_MAX))
+                        continue;
+                    if (sample.depth == MaxStackDepth)
+                        break;
+                    sample.frames[sample.depth++] = address;
+                }
+                if (sample.depth != 0)
+                    samples.push_back(sample);
+            }
+        }
+
+        __atomic_store_n(&page->data_tail, tail, __ATOMIC_RELEASE);
+    }
+
+    // NOTE: A retired thread was stopped before it exited, with its rings
+    // drained above nothing of it is left to collect
+    for (std::size_t i = 0; i < mThreads.size();) {
+        if (!mThreads[i]->isRetired) {
+            i++;
+            continue;
+        }
+
+        releaseThread(*mThreads[i]);
+        mThreads.erase(mThreads.begin() + i);
+    }
+
+    return samples.size() - before;
+};
+
+uint64_t Sampler::takeDropped() {
+    std::lock_guard<std::mutex> lock(mMutex);
+    const uint64_t dropped = mDropped;
+    mDropped = 0;
+    return dropped;
+};
+
+#else // Sampling needs Linux, everywhere else it reports no backend
+
+struct Sampler::SampledThread {};
+
+Sampler::Sampler() {};
+Sampler::~Sampler() {};
+
+void Sampler::registerThread(uint32_t) {};
+void Sampler::retireThread(SampledThread &) {};
+SamplerBackend Sampler::start() { return SamplerBackend::None; };
+void Sampler::stop() {};
+bool Sampler::startThread(SampledThread &) { return false; };
+void Sampler::stopThread(SampledThread &) {};
+void Sampler::releaseThread(SampledThread &) {};
+uint64_t Sampler::toTicks(uint64_t nanoseconds) const { return nanoseconds; };
+std::size_t Sampler::drain(std::vector<StackSample> &) { return 0; };
+uint64_t Sampler::takeDropped() { return 0; };
+
+#endif
+
+} // namespace GTFO
@@ -0,0 +1,87 @@
+#ifndef __GTFO_SAMPLER_H
+#define __GTFO_SAMPLER_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace GTFO {
+const uint32_t MaxStackDepth = 64;
+
+// One captured call stack, innermost frame first
+struct StackSample {
+    uint32_t threadId; // GTFO thread id, matches the thread's scope track
+    uint64_t ticks;    // Clock ticks
+    uint32_t depth;
+    uint64_t frames[MaxStackDepth];
+};
+
+enum class SamplerBackend {
+    None,
+    PerfEvent, // perf_event_open, the kernel walks the stack
+    Signal,    // SIGPROF from a per-thread CPU-time timer, backtrace()
+};
+
+/**
+ * Statistical stack sampler for threads that opted in. Samples are taken
+ * every 1 / frequency seconds of the thread's CPU time and only hold raw
+ * return addresses, symbols are resolved offline by the converter.
+ *
+ * Linux only. perf_event_open needs kernel.perf_event_paranoid <= 2, the
+ * signal fallback works everywhere else. Both walk frame pointers or
+ * unwind tables, build with -fno-omit-frame-pointer for full stacks.
+ * GTFO_SAMPLE_HZ sets the initial frequency, GTFO_SAMPLER=signal skips
+ * perf_event_open.
+ */
+class Sampler {
+  public:
+    struct SampledThread;
+
+  private:
+    std::mutex mMutex;
+    std::vector<std::unique_ptr<SampledThread>> mThreads;
+    uint32_t mFrequency{0};
+    bool mIsSignalForced{false};
+    SamplerBackend mBackend{SamplerBackend::None};
+    bool mIsRunning{false};
+    uint64_t mDropped{0};
+
+    // perf_event timestamps are CLOCK_MONOTONIC_RAW nanoseconds
+    uint64_t mAnchorTicks{0};
+    uint64_t mAnchorNanoseconds{0};
+    double mTicksPerNanosecond{1.0};
+
+    bool startThread(SampledThread &thread);
+    bool startWithFallback(SampledThread &thread);
+    void stopThread(SampledThread &thread);
+    void releaseThread(SampledThread &thread);
+    uint64_t toTicks(uint64_t nanoseconds) const;
+
+  public:
+    Sampler();
+    ~Sampler();
+
+    void setFrequency(uint32_t frequency) { mFrequency = frequency; };
+    uint32_t frequency() const { return mFrequency; };
+    SamplerBackend backend() const { return mBackend; };
+
+    // Samples the calling thread from the next start() on, or right away
+    // when the sampler is running. The thread stops being sampled when it
+    // exits.
+    void registerThread(uint32_t threadId);
+    void retireThread(SampledThread &thread);
+
+    SamplerBackend start();
+    void stop();
+
+    // Appends every sample captured since the last call, safe to call
+    // after stop(). Threads that exited are freed once drained.
+    std::size_t drain(std::vector<StackSample> &samples);
+    uint64_t takeDropped();
+};
+}; // namespace GTFO
+
+#endif // END OF __GTFO_SAMPLER_H
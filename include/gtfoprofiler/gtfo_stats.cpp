@@ -0,0 +1,340 @@
+#include "gtfo_stats.h"
+#include "gtfo_trace_writer.h"
+
+#include <algorithm>
+#include <cstdio>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace GTFO {
+
+namespace {
+const std::size_t SubBucketCount = std::size_t(1) << Histogram::SubBucketBits;
+
+int highestBit(uint64_t value) {
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanReverse64(&index, value);
+    return static_cast<int>(index);
+#else
+    return 63 - __builtin_clzll(value);
+#endif
+};
+
+// Children sorted by total time, the order a reader wants them in
+template <typename Entry>
+bool byTotalDescending(const Entry &a, const Entry &b) {
+    return a.second->stats.sum > b.second->stats.sum;
+};
+} // namespace
+
+std::size_t Histogram::bucketIndex(uint64_t value) {
+    if (value < SubBucketCount)
+        return static_cast<std::size_t>(value);
+
+    const int bit = highestBit(value);
+    const int magnitude = (bit < MaxMagnitude) ? bit : MaxMagnitude;
+    const int shift = magnitude - SubBucketBits;
+    const uint64_t subBucket =
+        (bit > MaxMagnitude)
+            ? SubBucketCount - 1
+            : (value >> shift) - SubBucketCount;
+
+    return (static_cast<std::size_t>(shift + 1) << SubBucketBits) +
+           static_cast<std::size_t>(subBucket);
+};
+
+uint64_t Histogram::bucketMidpoint(std::size_t index) {
+    if (index < SubBucketCount)
+        return index;
+
+    const int shift = static_cast<int>(index >> SubBucketBits) - 1;
+    const uint64_t lower = (SubBucketCount + (index & (SubBucketCount - 1)))
+                           << shift;
+    return lower + ((uint64_t(1) << shift) >> 1);
+};
+
+void Histogram::record(uint64_t value) {
+    std::atomic<uint32_t> &bucket = mBuckets[bucketIndex(value)];
+    bucket.store(bucket.load(std::memory_order_relaxed) + 1,
+                 std::memory_order_relaxed);
+
+    mCount.store(mCount.load(std::memory_order_relaxed) + 1,
+                 std::memory_order_relaxed);
+    mSum.store(mSum.load(std::memory_order_relaxed) + value,
+               std::memory_order_relaxed);
+    if (value < mMin.load(std::memory_order_relaxed))
+        mMin.store(value, std::memory_order_relaxed);
+    if (value > mMax.load(std::memory_order_relaxed))
+        mMax.store(value, std::memory_order_relaxed);
+};
+
+// NOTE: Racing with the owner can lose an update made during the reset,
+// which is fine for statistics
+void Histogram::reset() {
+    for (std::size_t i = 0; i < BucketCount; i++)
+        mBuckets[i].store(0, std::memory_order_relaxed);
+
+    mCount.store(0, std::memory_order_relaxed);
+    mSum.store(0, std::memory_order_relaxed);
+    mMin.store(UINT64_MAX, std::memory_order_relaxed);
+    mMax.store(0, std::memory_order_relaxed);
+};
+
+void HistogramSnapshot::merge(const Histogram &histogram) {
+    for (std::size_t i = 0; i < Histogram::BucketCount; i++)
+        buckets[i] += histogram.mBuckets[i].load(std::memory_order_relaxed);
+
+    count += histogram.mCount.load(std::memory_order_relaxed);
+    sum += histogram.mSum.load(std::memory_order_relaxed);
+    min = std::min(min, histogram.mMin.load(std::memory_order_relaxed));
+    max = std::max(max, histogram.mMax.load(std::memory_order_relaxed));
+};
+
+void HistogramSnapshot::merge(const HistogramSnapshot &snapshot) {
+    for (std::size_t i = 0; i < Histogram::BucketCount; i++)
+        buckets[i] += snapshot.buckets[i];
+
+    count += snapshot.count;
+    sum += snapshot.sum;
+    min = std::min(min, snapshot.min);
+    max = std::max(max, snapshot.max);
+};
+
+uint64_t HistogramSnapshot::percentile(double fraction) const {
+    if (count == 0)
+        return 0;
+
+    const uint64_t rank = std::max<uint64_t>(
+        1, static_cast<uint64_t>(fraction * static_cast<double>(count) + 0.5));
+
+    uint64_t seen = 0;
+    for (std::size_t i = 0; i < buckets.size(); i++) {
+        seen += buckets[i];
+        if (seen >= rank)
+            return std::min(std::max(Histogram::bucketMidpoint(i), min), max);
+    }
+    return max;
+};
+
+StatsNode *StatsNode::child(const char *childName) {
+    for (StatsNode *node = firstChild.load(std::memory_order_relaxed);
+         node != nullptr; node = node->nextSibling) {
+        if (node->name == childName)
+            return node;
+    }
+
+    StatsNode *node = new StatsNode(childName, this);
+    node->nextSibling = firstChild.load(std::memory_order_relaxed);
+    firstChild.store(node, std::memory_order_release);
+    return node;
+};
+
+void StatsNode::recordAllocations(uint64_t count, uint64_t bytes) {
+    allocations.store(allocations.load(std::memory_order_relaxed) + count,
+                      std::memory_order_relaxed);
+    allocatedBytes.store(
+        allocatedBytes.load(std::memory_order_relaxed) + bytes,
+        std::memory_order_relaxed);
+};
+
+void SummaryWriter::addThread(const ThreadStats &thread) {
+    mThreadCount++;
+    mergeNode(thread.root, mTree);
+};
+
+// Pointers differ between translation units for the same literal, so
+// children are merged by their text
+void SummaryWriter::mergeNode(const StatsNode &source, Node &target) {
+    for (const StatsNode *child =
+             source.firstChild.load(std::memory_order_acquire);
+         child != nullptr; child = child->nextSibling) {
+        HistogramSnapshot snapshot;
+        snapshot.merge(child->histogram);
+        if (snapshot.count == 0 &&
+            child->firstChild.load(std::memory_order_acquire) == nullptr)
+            continue;
+
+        const uint64_t allocations =
+            child->allocations.load(std::memory_order_relaxed);
+        const uint64_t allocatedBytes =
+            child->allocatedBytes.load(std::memory_order_relaxed);
+        mHasAllocations = mHasAllocations || allocations != 0;
+
+        Node &node = target.children[child->name];
+        node.stats.merge(snapshot);
+        node.allocations += allocations;
+        node.allocatedBytes += allocatedBytes;
+
+        Node &byName = mByName[child->name];
+        byName.stats.merge(snapshot);
+        byName.allocations += allocations;
+        byName.allocatedBytes += allocatedBytes;
+
+        mergeNode(*child, node);
+    }
+};
+
+double SummaryWriter::toMicroseconds(uint64_t ticks) const {
+    return static_cast<double>(ticks) * 1e6 /
+           static_cast<double>(mTicksPerSecond);
+};
+
+void SummaryWriter::write(std::ostream &out, SummaryFormat format) const {
+    typedef std::pair<const std::string, Node> NameEntry;
+    std::vector<const NameEntry *> names;
+    for (std::map<std::string, Node>::const_iterator it = mByName.begin();
+         it != mByName.end(); ++it)
+        names.push_back(&*it);
+    std::sort(names.begin(), names.end(),
+              [](const NameEntry *a, const NameEntry *b) {
+                  return a->second.stats.sum > b->second.stats.sum;
+              });
+
+    if (format == SummaryFormat::Table) {
+        out << "GTFO summary: " << mSessionName << " (" << mThreadCount
+            << " threads)\n\n";
+        writeTableHeader(out);
+        for (std::size_t i = 0; i < names.size(); i++)
+            writeTableRow(out, names[i]->first, names[i]->second);
+
+        out << "\nCall tree\n";
+        writeTableHeader(out);
+        writeTableTree(out, mTree, 0);
+        return;
+    }
+
+    std::string json = "{\"session\":";
+    appendJSONString(json, mSessionName.c_str());
+    json += ",\"threads\":" + std::to_string(mThreadCount);
+    json += ",\"scopes\":[";
+    for (std::size_t i = 0; i < names.size(); i++) {
+        if (i != 0)
+            json += ',';
+        json += "\n{\"name\":";
+        appendJSONString(json, names[i]->first.c_str());
+        writeJSONStats(json, names[i]->second);
+        json += '}';
+    }
+    json += "],\n\"callTree\":";
+    writeJSONTree(json, "", mTree);
+    json += "}\n";
+    out << json;
+};
+
+// NOTE: The allocation columns only appear when the tracker saw any
+void SummaryWriter::writeTableHeader(std::ostream &out) const {
+    char header[192];
+    int length = std::snprintf(
+        header, sizeof(header), "%-40s %10s %12s %10s %10s %10s %10s %10s %10s",
+        "Scope", "Count", "Total ms", "Mean us", "Min us", "p50 us", "p90 us",
+        "p99 us", "Max us");
+    if (mHasAllocations)
+        std::snprintf(header + length, sizeof(header) - length, " %10s %10s",
+                      "Allocs", "Alloc KB");
+    out << header << '\n';
+};
+
+void SummaryWriter::writeTableRow(std::ostream &out, const std::string &label,
+                                  const Node &node) const {
+    const HistogramSnapshot &stats = node.stats;
+    if (stats.count == 0) {
+        out << label << '\n';
+        return;
+    }
+
+    char row[256];
+    std::snprintf(
+        row, sizeof(row),
+        "%-40s %10llu %12.3f %10.3f %10.3f %10.3f %10.3f %10.3f %10.3f",
+        label.c_str(), static_cast<unsigned long long>(stats.count),
+        toMicroseconds(stats.sum) / 1e3,
+        toMicroseconds(stats.sum) / static_cast<double>(stats.count),
+        toMicroseconds(stats.min), toMicroseconds(stats.percentile(0.5)),
+        toMicroseconds(stats.percentile(0.9)),
+        toMicroseconds(stats.percentile(0.99)), toMicroseconds(stats.max));
+    out << row;
+
+    if (mHasAllocations) {
+        std::snprintf(row, sizeof(row), " %10llu %10.1f",
+                      static_cast<unsigned long long>(node.allocations),
+                      static_cast<double>(node.allocatedBytes) / 1024.0);
+        out << row;
+    }
+    out << '\n';
+};
+
+void SummaryWriter::writeTableTree(std::ostream &out, const Node &node,
+                                   int depth) const {
+    typedef std::pair<std::string, const Node *> Entry;
+    std::vector<Entry> children;
+    for (std::map<std::string, Node>::const_iterator it =
+             node.children.begin();
+         it != node.children.end(); ++it)
+        children.push_back(Entry(it->first, &it->second));
+    std::sort(children.begin(), children.end(), byTotalDescending<Entry>);
+
+    for (std::size_t i = 0; i < children.size(); i++) {
+        writeTableRow(out, std::string(depth * 2, ' ') + children[i].first,
+                      *children[i].second);
+        writeTableTree(out, *children[i].second, depth + 1);
+    }
+};
+
+void SummaryWriter::writeJSONStats(std::string &out, const Node &node) const {
+    const HistogramSnapshot &stats = node.stats;
+    char fields[384];
+    std::snprintf(
+        fields, sizeof(fields),
+        ",\"count\":%llu,\"totalUs\":%.3f,\"meanUs\":%.3f,\"minUs\":%.3f,"
+        "\"p50Us\":%.3f,\"p90Us\":%.3f,\"p99Us\":%.3f,\"maxUs\":%.3f,"
+        "\"allocations\":%llu,\"allocatedBytes\":%llu",
+        static_cast<unsigned long long>(stats.count),
+        toMicroseconds(stats.sum),
+        stats.count != 0
+            ? toMicroseconds(stats.sum) / static_cast<double>(stats.count)
+            : 0.0,
+        stats.count != 0 ? toMicroseconds(stats.min) : 0.0,
+        toMicroseconds(stats.percentile(0.5)),
+        toMicroseconds(stats.percentile(0.9)),
+        toMicroseconds(stats.percentile(0.99)), toMicroseconds(stats.max),
+        static_cast<unsigned long long>(node.allocations),
+        static_cast<unsigned long long>(node.allocatedBytes));
+    out += fields;
+};
+
+void SummaryWriter::writeJSONTree(std::string &out, const std::string &name,
+                                  const Node &node) const {
+    uint64_t childTicks = 0;
+    for (std::map<std::string, Node>::const_iterator it =
+             node.children.begin();
+         it != node.children.end(); ++it)
+        childTicks += it->second.stats.sum;
+
+    out += "{\"name\":";
+    appendJSONString(out, name.c_str());
+    writeJSONStats(out, node);
+
+    char self[64];
+    std::snprintf(self, sizeof(self), ",\"selfUs\":%.3f",
+                  node.stats.sum > childTicks
+                      ? toMicroseconds(node.stats.sum - childTicks)
+                      : 0.0);
+    out += self;
+
+    out += ",\"children\":[";
+    bool isFirst = true;
+    for (std::map<std::string, Node>::const_iterator it =
+             node.children.begin();
+         it != node.children.end(); ++it) {
+        if (!isFirst)
+            out += ',';
+        isFirst = false;
+        writeJSONTree(out, it->first, it->second);
+    }
+    out += "]}";
+};
+
+} // namespace GTFO
@@ -0,0 +1,140 @@
+#ifndef __GTFO_STATS_H
+#define __GTFO_STATS_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace GTFO {
+/**
+ * Log-bucketed duration histogram in the style of HdrHistogram. Every power
+ * of two is split into 2^SubBucketBits linear buckets, so any recorded
+ * value is known to within about 6%. Only the owning thread records, with
+ * relaxed loads and stores instead of read-modify-writes, and any thread
+ * may read a slightly stale snapshot at the same time.
+ */
+class Histogram {
+  public:
+    // NOTE: Only ever used by value, C++11 would need an out-of-line
+    // definition for any reference bound to them, std::min included
+    static constexpr int SubBucketBits = 4;
+    static constexpr int MaxMagnitude = 47; // larger land in the last bucket
+    static constexpr std::size_t BucketCount =
+        static_cast<std::size_t>(MaxMagnitude - SubBucketBits + 2)
+        << SubBucketBits;
+
+  private:
+    std::atomic<uint32_t> mBuckets[BucketCount];
+    std::atomic<uint64_t> mCount;
+    std::atomic<uint64_t> mSum;
+    std::atomic<uint64_t> mMin;
+    std::atomic<uint64_t> mMax;
+
+  public:
+    Histogram() { reset(); };
+
+    static std::size_t bucketIndex(uint64_t value);
+    static uint64_t bucketMidpoint(std::size_t index);
+
+    void record(uint64_t value);
+    void reset();
+
+    friend struct HistogramSnapshot;
+};
+
+// Plain copy of one or more histograms, merged across threads for reporting
+struct HistogramSnapshot {
+    std::vector<uint64_t> buckets;
+    uint64_t count{0};
+    uint64_t sum{0};
+    uint64_t min{UINT64_MAX};
+    uint64_t max{0};
+
+    HistogramSnapshot() : buckets(Histogram::BucketCount, 0){};
+
+    void merge(const Histogram &histogram);
+    void merge(const HistogramSnapshot &snapshot);
+    uint64_t percentile(double fraction) const;
+};
+
+/**
+ * One call path on one thread. Children are pushed onto an intrusive list
+ * with a release store, so the summary can walk the tree while its owner
+ * keeps adding to it. Nodes live as long as the profiler.
+ */
+struct StatsNode {
+    const char *name;
+    StatsNode *parent;
+    std::atomic<StatsNode *> firstChild{nullptr};
+    StatsNode *nextSibling{nullptr};
+    Histogram histogram;
+    std::atomic<uint64_t> allocations{0}; // only with allocation tracking
+    std::atomic<uint64_t> allocatedBytes{0};
+
+    StatsNode(const char *nodeName, StatsNode *parentNode)
+        : name(nodeName), parent(parentNode){};
+
+    // Only called by the owning thread
+    StatsNode *child(const char *childName);
+    void recordAllocations(uint64_t count, uint64_t bytes);
+};
+
+struct ThreadStats {
+    uint32_t threadId;
+    StatsNode root{"", nullptr};
+    StatsNode *current{&root};
+
+    explicit ThreadStats(uint32_t id) : threadId(id){};
+};
+
+enum class SummaryFormat {
+    Table, // fixed-width text, flat per scope name then the call tree
+    JSON,
+};
+
+/**
+ * Merges the per-thread trees by scope name and writes them out. Durations
+ * are in clock ticks until here, ticksPerSecond converts them for display.
+ */
+class SummaryWriter {
+  private:
+    struct Node {
+        HistogramSnapshot stats;
+        uint64_t allocations{0};
+        uint64_t allocatedBytes{0};
+        std::map<std::string, Node> children;
+    };
+
+    std::string mSessionName;
+    uint64_t mTicksPerSecond;
+    std::size_t mThreadCount{0};
+    bool mHasAllocations{false};
+    Node mTree;
+    std::map<std::string, Node> mByName; // children unused
+
+    void mergeNode(const StatsNode &source, Node &target);
+
+    double toMicroseconds(uint64_t ticks) const;
+    void writeTableHeader(std::ostream &out) const;
+    void writeTableRow(std::ostream &out, const std::string &label,
+                       const Node &node) const;
+    void writeTableTree(std::ostream &out, const Node &node,
+                        int depth) const;
+    void writeJSONStats(std::string &out, const Node &node) const;
+    void writeJSONTree(std::string &out, const std::string &name,
+                       const Node &node) const;
+
+  public:
+    SummaryWriter(const char *sessionName, uint64_t ticksPerSecond)
+        : mSessionName(sessionName), mTicksPerSecond(ticksPerSecond){};
+
+    void addThread(const ThreadStats &thread);
+    void write(std::ostream &out, SummaryFormat format) const;
+};
+}; // namespace GTFO
+
+#endif // END OF __GTFO_STATS_H
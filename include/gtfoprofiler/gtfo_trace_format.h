@@ -0,0 +1,141 @@
+#ifndef __GTFO_TRACE_FORMAT_H
+#define __GTFO_TRACE_FORMAT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/**
+ * GTFO binary trace format (.gtfo), little-endian. Live streams over a Unix
+ * socket carry the same header and records.
+ *
+ *   Header   : magic "GTFOTRC\0", u32 version, u32 reserved,
+ *              u64 ticks per second, u64 session origin in ticks
+ *   Records  : u8 tag followed by varint fields
+ *     String   : id, byte length, bytes (defined before first use)
+ *     Event records share a prefix of process id, thread id, name id,
+ *     category id, zigzag(start - previous start on that track), then
+ *     Complete : duration, heap allocations made inside the scope
+ *     Instant  : nothing
+ *     Counter  : fixed64 bits of the double value
+ *     Frame    : frame number
+ *     Sample   : stack depth, zigzag(frame - previous frame) per frame,
+ *                innermost first, the first relative to 0
+ *     Metadata : name id, process id, thread id, arg name id, value
+ *     Name     : name id, process id, thread id, value string id
+ *     Module   : path string id, start address, end address, file offset
+ *                of an executable mapping, for offline symbolization
+ *     Reset    : total bytes dropped so far, live streams only. The
+ *                string table and every track's previous start restart
+ *                from empty and 0
+ *     End      : no fields, last record of a complete trace
+ *
+ * Timestamps are ticks relative to the session origin.
+ */
+namespace GTFO {
+namespace Format {
+
+const char Magic[8] = {'G', 'T', 'F', 'O', 'T', 'R', 'C', '\0'};
+const uint32_t Version = 5;
+const std::size_t HeaderSize = 32;
+
+enum RecordTag : uint8_t {
+    TagString = 1,
+    TagComplete = 2,
+    TagMetadata = 3,
+    TagName = 4,
+    TagInstant = 5,
+    TagCounter = 6,
+    TagFrame = 7,
+    TagSample = 8,
+    TagModule = 9,
+    TagReset = 10,
+    TagEnd = 0xFF,
+};
+
+inline void appendFixed32(std::string &out, uint32_t value) {
+    for (int i = 0; i < 4; i++)
+        out += static_cast<char>((value >> (8 * i)) & 0xFF);
+};
+
+inline void appendFixed64(std::string &out, uint64_t value) {
+    for (int i = 0; i < 8; i++)
+        out += static_cast<char>((value >> (8 * i)) & 0xFF);
+};
+
+inline void appendVarint(std::string &out, uint64_t value) {
+    while (value >= 0x80) {
+        out += static_cast<char>((value & 0x7F) | 0x80);
+        value >>= 7;
+    }
+    out += static_cast<char>(value);
+};
+
+inline uint64_t zigzag(int64_t value) {
+    return (static_cast<uint64_t>(value) << 1) ^
+           static_cast<uint64_t>(value >> 63);
+};
+
+inline int64_t unzigzag(uint64_t value) {
+    return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+};
+
+/**
+ * Bounds-checked cursor over an in-memory trace. Every read returns false
+ * once the data runs out, which is how a truncated trace is detected.
+ */
+class Reader {
+  private:
+    const unsigned char *mData;
+    std::size_t mSize;
+    std::size_t mOffset{0};
+
+  public:
+    Reader(const void *data, std::size_t size)
+        : mData(static_cast<const unsigned char *>(data)), mSize(size){};
+
+    bool isAtEnd() const { return mOffset >= mSize; };
+    std::size_t offset() const { return mOffset; };
+
+    bool readByte(uint8_t &value) {
+        if (mOffset >= mSize)
+            return false;
+        value = mData[mOffset++];
+        return true;
+    };
+
+    bool readFixed(uint64_t &value, int byteCount) {
+        if (mSize - mOffset < static_cast<std::size_t>(byteCount))
+            return false;
+        value = 0;
+        for (int i = 0; i < byteCount; i++)
+            value |= static_cast<uint64_t>(mData[mOffset++]) << (8 * i);
+        return true;
+    };
+
+    bool readVarint(uint64_t &value) {
+        value = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            uint8_t byte;
+            if (!readByte(byte))
+                return false;
+            value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+            if ((byte & 0x80) == 0)
+                return true;
+        }
+        return false;
+    };
+
+    bool readBytes(std::string &value, std::size_t length) {
+        if (mSize - mOffset < length)
+            return false;
+        value.assign(reinterpret_cast<const char *>(mData + mOffset), length);
+        mOffset += length;
+        return true;
+    };
+};
+
+} // namespace Format
+} // namespace GTFO
+
+#endif // END OF __GTFO_TRACE_FORMAT_H
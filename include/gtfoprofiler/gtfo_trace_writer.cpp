@@ -0,0 +1,600 @@
+#include "gtfo_trace_writer.h"
+#include "gtfo_profiler.h"
+#include "gtfo_sampler.h"
+#include "gtfo_trace_format.h"
+
+#include <cstdio>
+#include <cstring>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+#define GTFO_HAS_LIVE_STREAM
+#endif
+
+namespace GTFO {
+
+namespace {
+const char LivePrefix[] = "unix:";
+
+#ifdef GTFO_HAS_LIVE_STREAM
+// NOTE: A consumer that stops reading for this long is disconnected, so
+// close() cannot hang on it
+const long SendTimeoutMicroseconds = 500000;
+
+int connectSocket(const char *socketPath) {
+    sockaddr_un address;
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (std::strlen(socketPath) >= sizeof(address.sun_path))
+        return -1;
+    std::strcpy(address.sun_path, socketPath);
+
+    const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0)
+        return -1;
+
+    timeval timeout;
+    timeout.tv_sec = 0;
+    timeout.tv_usec = SendTimeoutMicroseconds;
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+#ifdef SO_NOSIGPIPE
+    const int isSet = 1;
+    setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &isSet, sizeof(isSet));
+#endif
+
+    if (connect(fd, reinterpret_cast<sockaddr *>(&address),
+                sizeof(address)) != 0) {
+        ::close(fd);
+        return -1;
+    }
+    return fd;
+};
+#endif
+} // namespace
+
+TraceFormat TraceWriter::formatForPath(const char *filePath) {
+    if (isLivePath(filePath))
+        return TraceFormat::Binary;
+
+    const char *extension = std::strrchr(filePath, '.');
+    if (extension != nullptr && std::strcmp(extension, ".gtfo") == 0)
+        return TraceFormat::Binary;
+
+    return TraceFormat::ChromeJSON;
+};
+
+bool TraceWriter::isLivePath(const char *filePath) {
+    return std::strncmp(filePath, LivePrefix, sizeof(LivePrefix) - 1) == 0;
+};
+
+bool TraceWriter::open(const char *filePath, uint64_t originTicks,
+                       uint64_t ticksPerSecond, TraceFormat format) {
+    mIsLive = isLivePath(filePath);
+    mIsStreamBroken = false;
+    mDroppedBytes = 0;
+
+    if (mIsLive) {
+        // Live streams are always binary, the collector parses records
+        format = TraceFormat::Binary;
+#ifdef GTFO_HAS_LIVE_STREAM
+        mSocket = connectSocket(filePath + sizeof(LivePrefix) - 1);
+#endif
+    } else {
+        std::ios::openmode mode = std::ios::out | std::ios::trunc;
+        if (format == TraceFormat::Binary)
+            mode |= std::ios::binary;
+        mStream.open(filePath, mode);
+    }
+
+    mFormat = format;
+    mOriginTicks = originTicks;
+    mTicksPerSecond = ticksPerSecond;
+    mNanosecondsPerTick = 1e9 / static_cast<double>(ticksPerSecond);
+    mHasEvents = false;
+
+    mChunk.clear();
+    mChunk.reserve(FlushThreshold + 1024);
+    mPendingChunk.reserve(FlushThreshold + 1024);
+
+    if (mFormat == TraceFormat::Binary) {
+        mChunk.append(Format::Magic, sizeof(Format::Magic));
+        Format::appendFixed32(mChunk, Format::Version);
+        Format::appendFixed32(mChunk, 0);
+        Format::appendFixed64(mChunk, ticksPerSecond);
+        Format::appendFixed64(mChunk, originTicks);
+    } else {
+        mChunk += '[';
+    }
+
+    mStopFlusher = false;
+    mFlusherThread = std::thread(&TraceWriter::flusherLoop, this);
+    return isOpen();
+};
+
+void TraceWriter::writeEvent(const ProfileResult &result, uint32_t processId,
+                             uint32_t threadId) {
+    // Started before the session did, e.g. a scope or GPU frame straddling
+    // two sessions, and would underflow the relative timestamp
+    if (result.start < mOriginTicks)
+        return;
+
+    if (mFormat == TraceFormat::Binary)
+        writeEventBinary(result, processId, threadId);
+    else
+        writeEventJSON(result, processId, threadId);
+
+    if (mChunk.size() >= FlushThreshold)
+        flushChunk();
+};
+
+// Nested scopes are pushed when they end, so starts on one track are not
+// monotonic and the delta needs a sign
+void TraceWriter::appendEventPrefix(uint8_t tag, const char *name,
+                                    const char *category, uint64_t ticks,
+                                    uint32_t processId, uint32_t threadId) {
+    const uint64_t nameId = stringId(name);
+    const uint64_t categoryId = stringId(category);
+    const uint64_t start = ticks - mOriginTicks;
+
+    uint64_t &lastStart =
+        mLastStartTicks[(static_cast<uint64_t>(processId) << 32) | threadId];
+    const int64_t delta = static_cast<int64_t>(start - lastStart);
+    lastStart = start;
+
+    mChunk += static_cast<char>(tag);
+    Format::appendVarint(mChunk, processId);
+    Format::appendVarint(mChunk, threadId);
+    Format::appendVarint(mChunk, nameId);
+    Format::appendVarint(mChunk, categoryId);
+    Format::appendVarint(mChunk, Format::zigzag(delta));
+};
+
+void TraceWriter::writeEventBinary(const ProfileResult &result,
+                                   uint32_t processId, uint32_t threadId) {
+    Format::RecordTag tag = Format::TagComplete;
+    switch (result.type) {
+    case EventType::Instant:
+        tag = Format::TagInstant;
+        break;
+    case EventType::Counter:
+        tag = Format::TagCounter;
+        break;
+    case EventType::Frame:
+        tag = Format::TagFrame;
+        break;
+    default:
+        break;
+    }
+
+    appendEventPrefix(tag, result.name, result.category, result.start,
+                      processId, threadId);
+
+    switch (result.type) {
+    case EventType::Complete:
+        Format::appendVarint(mChunk, result.end - result.start);
+        Format::appendVarint(mChunk, result.allocations);
+        break;
+    case EventType::Counter:
+        Format::appendFixed64(mChunk, result.end);
+        break;
+    case EventType::Frame:
+        Format::appendVarint(mChunk, result.end);
+        break;
+    default:
+        break;
+    }
+};
+
+void TraceWriter::writeEventJSON(const ProfileResult &result,
+                                 uint32_t processId, uint32_t threadId) {
+    beginEvent();
+    mChunk += "\"name\":";
+    mChunk += escaped(result.name);
+    mChunk += ",\"cat\":";
+    mChunk += escaped(result.category);
+
+    switch (result.type) {
+    case EventType::Complete:
+        mChunk += ",\"ph\":\"X\",\"ts\":";
+        appendMicroseconds(result.start - mOriginTicks);
+        mChunk += ",\"dur\":";
+        appendMicroseconds(result.end - result.start);
+        appendTrack(processId, threadId);
+        if (result.allocations != 0) {
+            mChunk += ",\"args\":{\"allocations\":";
+            appendUnsigned(result.allocations);
+            mChunk += '}';
+        }
+        break;
+
+    case EventType::Instant:
+        mChunk += ",\"ph\":\"i\",\"s\":\"t\",\"ts\":";
+        appendMicroseconds(result.start - mOriginTicks);
+        appendTrack(processId, threadId);
+        break;
+
+    case EventType::Counter:
+        mChunk += ",\"ph\":\"C\",\"ts\":";
+        appendMicroseconds(result.start - mOriginTicks);
+        appendTrack(processId, threadId);
+        mChunk += ",\"args\":{\"value\":";
+        appendDouble(counterValue(result));
+        mChunk += '}';
+        break;
+
+    case EventType::Frame:
+        mChunk += ",\"ph\":\"i\",\"s\":\"g\",\"ts\":";
+        appendMicroseconds(result.start - mOriginTicks);
+        appendTrack(processId, threadId);
+        mChunk += ",\"args\":{\"frame\":";
+        appendUnsigned(result.end);
+        mChunk += '}';
+        break;
+    }
+
+    mChunk += '}';
+};
+
+void TraceWriter::writeMetadata(const char *name, uint32_t processId,
+                                uint32_t threadId, const char *argName,
+                                uint64_t argValue) {
+    if (mFormat == TraceFormat::Binary) {
+        const uint64_t nameId = stringId(name);
+        const uint64_t argNameId = stringId(argName);
+
+        mChunk += static_cast<char>(Format::TagMetadata);
+        Format::appendVarint(mChunk, nameId);
+        Format::appendVarint(mChunk, processId);
+        Format::appendVarint(mChunk, threadId);
+        Format::appendVarint(mChunk, argNameId);
+        Format::appendVarint(mChunk, argValue);
+        return;
+    }
+
+    beginEvent();
+    mChunk += "\"name\":";
+    mChunk += escaped(name);
+    mChunk += ",\"ph\":\"M\"";
+    appendTrack(processId, threadId);
+    mChunk += ",\"args\":{";
+    appendString(argName);
+    mChunk += ':';
+    appendUnsigned(argValue);
+    mChunk += "}}";
+};
+
+void TraceWriter::writeName(const char *name, uint32_t processId,
+                            uint32_t threadId, const char *value) {
+    if (mFormat == TraceFormat::Binary) {
+        const TrackName trackName = {name, processId, threadId, value};
+        appendName(trackName);
+        if (mIsLive)
+            mNames.push_back(trackName);
+        return;
+    }
+
+    beginEvent();
+    mChunk += "\"name\":";
+    mChunk += escaped(name);
+    mChunk += ",\"ph\":\"M\"";
+    appendTrack(processId, threadId);
+    mChunk += ",\"args\":{\"name\":";
+    appendString(value);
+    mChunk += "}}";
+};
+
+void TraceWriter::appendName(const TrackName &name) {
+    const uint64_t nameId = stringId(name.name);
+    const uint64_t valueId = stringId(name.value);
+
+    mChunk += static_cast<char>(Format::TagName);
+    Format::appendVarint(mChunk, nameId);
+    Format::appendVarint(mChunk, name.processId);
+    Format::appendVarint(mChunk, name.threadId);
+    Format::appendVarint(mChunk, valueId);
+};
+
+// NOTE: Raw addresses mean nothing without the module map, which is why
+// samples are only written to binary traces
+void TraceWriter::writeSample(const StackSample &sample, uint32_t processId) {
+    if (mFormat != TraceFormat::Binary || sample.ticks < mOriginTicks)
+        return;
+
+    appendEventPrefix(Format::TagSample, "Sample", "sample", sample.ticks,
+                      processId, sample.threadId);
+    Format::appendVarint(mChunk, sample.depth);
+
+    uint64_t previous = 0;
+    for (uint32_t i = 0; i < sample.depth; i++) {
+        Format::appendVarint(mChunk,
+                             Format::zigzag(static_cast<int64_t>(
+                                 sample.frames[i] - previous)));
+        previous = sample.frames[i];
+    }
+
+    if (mChunk.size() >= FlushThreshold)
+        flushChunk();
+};
+
+void TraceWriter::writeModule(const char *path, uint64_t start, uint64_t end,
+                              uint64_t offset) {
+    if (mFormat != TraceFormat::Binary)
+        return;
+
+    const uint64_t pathId = stringId(path);
+    mChunk += static_cast<char>(Format::TagModule);
+    Format::appendVarint(mChunk, pathId);
+    Format::appendVarint(mChunk, start);
+    Format::appendVarint(mChunk, end);
+    Format::appendVarint(mChunk, offset);
+};
+
+void TraceWriter::writeSymbolizedSample(const char *function,
+                                        const std::string &stack,
+                                        uint32_t processId, uint32_t threadId,
+                                        uint64_t ticks) {
+    if (mFormat != TraceFormat::ChromeJSON || ticks < mOriginTicks)
+        return;
+
+    beginEvent();
+    // NOTE: Not interned, so escaped on every call instead of cached
+    mChunk += "\"name\":";
+    appendJSONString(mChunk, function);
+    mChunk += ",\"cat\":\"sample\",\"ph\":\"i\",\"s\":\"t\",\"ts\":";
+    appendMicroseconds(ticks - mOriginTicks);
+    appendTrack(processId, threadId);
+    mChunk += ",\"args\":{\"stack\":";
+    appendJSONString(mChunk, stack.c_str());
+    mChunk += "}}";
+
+    if (mChunk.size() >= FlushThreshold)
+        flushChunk();
+};
+
+void TraceWriter::close() {
+    if (!mFlusherThread.joinable())
+        return;
+
+    if (mFormat == TraceFormat::Binary)
+        mChunk += static_cast<char>(Format::TagEnd);
+    else
+        mChunk += "]\n";
+    flushChunk(true);
+
+    {
+        std::lock_guard<std::mutex> lock(mFlushMutex);
+        mStopFlusher = true;
+    }
+    mFlushSignal.notify_all();
+    mFlusherThread.join();
+
+    mStream.close();
+#ifdef GTFO_HAS_LIVE_STREAM
+    if (mSocket >= 0)
+        ::close(mSocket);
+#endif
+    mSocket = -1;
+    mEscapedStrings.clear();
+    mStringIds.clear();
+    mLastStartTicks.clear();
+    mNames.clear();
+};
+
+// Emits a string table record the first time a pointer is seen
+uint64_t TraceWriter::stringId(const char *str) {
+    std::unordered_map<const char *, uint64_t>::iterator it =
+        mStringIds.find(str);
+    if (it != mStringIds.end())
+        return it->second;
+
+    const uint64_t id = mStringIds.size();
+    mStringIds[str] = id;
+
+    const char *value = (str != nullptr) ? str : "";
+    const std::size_t length = std::strlen(value);
+    mChunk += static_cast<char>(Format::TagString);
+    Format::appendVarint(mChunk, id);
+    Format::appendVarint(mChunk, length);
+    mChunk.append(value, length);
+    return id;
+};
+
+void appendJSONString(std::string &out, const char *str) {
+    out += '"';
+    for (const char *c = (str != nullptr) ? str : ""; *c != '\0'; c++) {
+        switch (*c) {
+        case '"':
+            out += "\\\"";
+            break;
+        case '\\':
+            out += "\\\\";
+            break;
+        case '\n':
+            out += "\\n";
+            break;
+        case '\t':
+            out += "\\t";
+            break;
+        default:
+            if (static_cast<unsigned char>(*c) < 0x20) {
+                char hex[8];
+                std::snprintf(hex, sizeof(hex), "\\u%04x", *c);
+                out += hex;
+            } else {
+                out += *c;
+            }
+        }
+    }
+    out += '"';
+};
+
+const std::string &TraceWriter::escaped(const char *str) {
+    std::unordered_map<const char *, std::string>::iterator it =
+        mEscapedStrings.find(str);
+    if (it != mEscapedStrings.end())
+        return it->second;
+
+    std::string &out = mEscapedStrings[str];
+    appendJSONString(out, str);
+    return out;
+};
+
+void TraceWriter::beginEvent() {
+    if (mHasEvents)
+        mChunk += ",\n";
+    mChunk += '{';
+    mHasEvents = true;
+};
+
+void TraceWriter::appendString(const char *str) { mChunk += escaped(str); };
+
+void TraceWriter::appendTrack(uint32_t processId, uint32_t threadId) {
+    mChunk += ",\"pid\":";
+    appendUnsigned(processId);
+    mChunk += ",\"tid\":";
+    appendUnsigned(threadId);
+};
+
+void TraceWriter::appendUnsigned(uint64_t value) {
+    char digits[20];
+    std::size_t count = 0;
+    do {
+        digits[count++] = static_cast<char>('0' + value % 10);
+        value /= 10;
+    } while (value != 0);
+
+    while (count > 0)
+        mChunk += digits[--count];
+};
+
+// NOTE: JSON has no NaN or infinity, a broken sample is written as 0
+void TraceWriter::appendDouble(double value) {
+    if (value != value || value - value != 0.0)
+        value = 0.0;
+
+    char digits[32];
+    const int length = std::snprintf(digits, sizeof(digits), "%.15g", value);
+    mChunk.append(digits, static_cast<std::size_t>(length));
+};
+
+// The trace format expects microseconds, sub-microsecond scopes keep their
+// nanoseconds as a fraction instead of collapsing to zero
+void TraceWriter::appendMicroseconds(uint64_t ticks) {
+    const uint64_t nanoseconds =
+        (mTicksPerSecond == 1000000000)
+            ? ticks
+            : static_cast<uint64_t>(static_cast<double>(ticks) *
+                                    mNanosecondsPerTick);
+
+    appendUnsigned(nanoseconds / 1000);
+
+    const uint64_t fraction = nanoseconds % 1000;
+    if (fraction == 0)
+        return;
+
+    char digits[4] = {'.', static_cast<char>('0' + fraction / 100),
+                      static_cast<char>('0' + fraction / 10 % 10),
+                      static_cast<char>('0' + fraction % 10)};
+    std::size_t count = 4;
+    while (digits[count - 1] == '0')
+        count--;
+    mChunk.append(digits, count);
+};
+
+void TraceWriter::flush() {
+    if (!mChunk.empty())
+        flushChunk();
+};
+
+// Hands the front chunk to the flusher, only blocks if the previous chunk is
+// still being written. Live streams drop the chunk instead unless it is the
+// last one.
+void TraceWriter::flushChunk(bool isFinal) {
+    std::unique_lock<std::mutex> lock(mFlushMutex);
+    if (mIsLive && !isFinal && mHasPendingChunk) {
+        lock.unlock();
+        dropChunk();
+        return;
+    }
+    mFlushSignal.wait(lock, [this] { return !mHasPendingChunk; });
+
+    mPendingChunk.swap(mChunk);
+    mHasPendingChunk = true;
+    lock.unlock();
+
+    mFlushSignal.notify_all();
+};
+
+void TraceWriter::flusherLoop() {
+    std::unique_lock<std::mutex> lock(mFlushMutex);
+    while (true) {
+        mFlushSignal.wait(lock,
+                          [this] { return mHasPendingChunk || mStopFlusher; });
+        if (!mHasPendingChunk)
+            break;
+
+        lock.unlock();
+        if (mIsLive) {
+            sendChunk(mPendingChunk);
+        } else {
+            mStream.write(mPendingChunk.data(),
+                          static_cast<std::streamsize>(mPendingChunk.size()));
+            mStream.flush();
+        }
+        lock.lock();
+
+        mPendingChunk.clear();
+        mHasPendingChunk = false;
+        mFlushSignal.notify_all();
+    }
+};
+
+// NOTE: Runs on the flusher thread. A consumer that disconnects or stalls
+// past the send timeout ends the stream, later chunks are discarded.
+void TraceWriter::sendChunk(const std::string &chunk) {
+#ifdef GTFO_HAS_LIVE_STREAM
+    if (mIsStreamBroken || mSocket < 0)
+        return;
+
+#ifdef MSG_NOSIGNAL
+    const int flags = MSG_NOSIGNAL;
+#else
+    const int flags = 0;
+#endif
+
+    std::size_t offset = 0;
+    while (offset < chunk.size()) {
+        const ssize_t sent =
+            send(mSocket, chunk.data() + offset, chunk.size() - offset, flags);
+        if (sent <= 0) {
+            mIsStreamBroken = true;
+            std::fprintf(stderr, "[GTFO] Live collector stopped reading, "
+                                 "streaming ends here\n");
+            return;
+        }
+        offset += static_cast<std::size_t>(sent);
+    }
+#else
+    (void)chunk;
+#endif
+};
+
+// The consumer is still busy with the previous chunk. Whatever this chunk
+// defined is lost with it, so the string table and deltas restart and the
+// track names are written again.
+void TraceWriter::dropChunk() {
+    mDroppedBytes += mChunk.size();
+    mChunk.clear();
+    mStringIds.clear();
+    mLastStartTicks.clear();
+
+    mChunk += static_cast<char>(Format::TagReset);
+    Format::appendVarint(mChunk, mDroppedBytes);
+    for (std::size_t i = 0; i < mNames.size(); i++)
+        appendName(mNames[i]);
+};
+
+} // namespace GTFO
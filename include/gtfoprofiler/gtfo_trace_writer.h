@@ -0,0 +1,141 @@
+#ifndef __GTFO_TRACE_WRITER_H
+#define __GTFO_TRACE_WRITER_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace GTFO {
+struct ProfileResult;
+struct StackSample;
+
+// Appends str as a quoted, escaped JSON string
+void appendJSONString(std::string &out, const char *str);
+
+enum class TraceFormat {
+    ChromeJSON, // Chrome trace event JSON array, loads directly in viewers
+    Binary,     // compact .gtfo format, see gtfo_trace_format.h
+};
+
+/**
+ * Hand-written streaming trace writer for Chrome trace JSON or the GTFO
+ * binary format. Events are
+ * serialized into the front chunk, once it grows past FlushThreshold it is
+ * swapped with the back chunk and a flusher thread writes it to the file
+ * while serialization continues. Memory stays at two chunks no matter how
+ * long the session runs. Names and categories are interned pointers, so each
+ * one is escaped once and reused for every event that references it.
+ *
+ * A "unix:<socket path>" target streams the binary format to a collector
+ * listening on that Unix domain socket instead. A live stream never waits
+ * for the consumer: a chunk that finds the previous one still in flight is
+ * dropped, and the stream restarts its string table and deltas behind a
+ * Reset record, followed by every track name written so far.
+ */
+class TraceWriter {
+  private:
+    static const std::size_t FlushThreshold = 1 << 16;
+
+    std::ofstream mStream;
+    int mSocket{-1};
+    bool mIsLive{false};
+    uint64_t mDroppedBytes{0};
+    std::string mChunk;
+    TraceFormat mFormat{TraceFormat::ChromeJSON};
+    bool mHasEvents{false};
+    uint64_t mOriginTicks{0};
+    uint64_t mTicksPerSecond{1000000000};
+    double mNanosecondsPerTick{1.0};
+
+    // ChromeJSON: interned pointer -> escaped JSON string
+    std::unordered_map<const char *, std::string> mEscapedStrings;
+
+    // Binary: interned pointer -> string table id, pid << 32 | tid -> last
+    // start
+    std::unordered_map<const char *, uint64_t> mStringIds;
+    std::unordered_map<uint64_t, uint64_t> mLastStartTicks;
+
+    // Live: track names written so far, repeated after every Reset
+    struct TrackName {
+        const char *name;
+        uint32_t processId;
+        uint32_t threadId;
+        const char *value;
+    };
+    std::vector<TrackName> mNames;
+
+    std::thread mFlusherThread;
+    std::mutex mFlushMutex;
+    std::condition_variable mFlushSignal;
+    std::string mPendingChunk;
+    bool mHasPendingChunk{false};
+    bool mStopFlusher{false};
+    bool mIsStreamBroken{false};
+
+    void flusherLoop();
+    void sendChunk(const std::string &chunk);
+    void dropChunk();
+
+    const std::string &escaped(const char *str);
+    uint64_t stringId(const char *str);
+    void appendEventPrefix(uint8_t tag, const char *name,
+                           const char *category, uint64_t ticks,
+                           uint32_t processId, uint32_t threadId);
+    void writeEventBinary(const ProfileResult &result, uint32_t processId,
+                          uint32_t threadId);
+    void writeEventJSON(const ProfileResult &result, uint32_t processId,
+                        uint32_t threadId);
+    void appendName(const TrackName &name);
+    void beginEvent();
+    void appendString(const char *str);
+    void appendTrack(uint32_t processId, uint32_t threadId);
+    void appendUnsigned(uint64_t value);
+    void appendDouble(double value);
+    void appendMicroseconds(uint64_t ticks);
+    void flushChunk(bool isFinal = false);
+
+  public:
+    // Paths ending in ".gtfo" and live streams use the binary format
+    static TraceFormat formatForPath(const char *filePath);
+    static bool isLivePath(const char *filePath);
+
+    bool open(const char *filePath, uint64_t originTicks,
+              uint64_t ticksPerSecond, TraceFormat format);
+    bool isOpen() const { return mStream.is_open() || mSocket >= 0; };
+    bool isLive() const { return mIsLive; };
+
+    // Hands whatever is buffered to the flusher, live streams call this
+    // every collector tick so the consumer is never a chunk behind
+    void flush();
+
+    void writeEvent(const ProfileResult &result, uint32_t processId,
+                    uint32_t threadId);
+    void writeMetadata(const char *name, uint32_t processId, uint32_t threadId,
+                       const char *argName, uint64_t argValue);
+
+    // "process_name" / "thread_name" metadata, labels a track in viewers
+    void writeName(const char *name, uint32_t processId, uint32_t threadId,
+                   const char *value);
+
+    // Binary only: a raw stack sample and the executable mappings needed
+    // to symbolize it
+    void writeSample(const StackSample &sample, uint32_t processId);
+    void writeModule(const char *path, uint64_t start, uint64_t end,
+                     uint64_t offset);
+
+    // ChromeJSON only: a sample the converter already symbolized, as an
+    // instant named after the innermost function
+    void writeSymbolizedSample(const char *function, const std::string &stack,
+                               uint32_t processId, uint32_t threadId,
+                               uint64_t ticks);
+
+    void close();
+};
+}; // namespace GTFO
+
+#endif // END OF __GTFO_TRACE_WRITER_H
@@ -0,0 +1,455 @@
+/**
+ * gtfo_collector
+ * Receives a live GTFO session over a Unix domain socket and keeps the last
+ * few seconds of events in memory. The window is written out as a .gtfo
+ * trace on SIGUSR1 or after a frame takes longer than the threshold,
+ * convert the dumps with gtfo_convert. A slow frame is dumped half a window
+ * later so the trace shows what followed it, and further slow frames until
+ * then go into the same dump.
+ *
+ * Usage: gtfo_collector <socket path> [--window seconds]
+ *                       [--frame-threshold ms] [--output prefix]
+ *
+ * Point the profiled program at it with a "unix:<socket path>" session.
+ */
+#include "gtfo_profiler.h"
+#include "gtfo_trace_format.h"
+#include "gtfo_trace_writer.h"
+
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <map>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace {
+volatile std::sig_atomic_t sIsDumpRequested = 0;
+volatile std::sig_atomic_t sIsStopRequested = 0;
+
+void onDumpSignal(int) { sIsDumpRequested = 1; };
+void onStopSignal(int) { sIsStopRequested = 1; };
+
+struct Options {
+    const char *socketPath{nullptr};
+    double windowSeconds{10.0};
+    double frameThresholdMs{0.0}; // 0 never dumps on slow frames
+    std::string outputPrefix{"gtfo_dump"};
+};
+
+struct TrackName {
+    const char *name;
+    uint32_t processId;
+    uint32_t threadId;
+    const char *value;
+};
+
+struct StoredEvent {
+    GTFO::ProfileResult result; // absolute ticks
+    uint32_t processId;
+    uint32_t threadId;
+};
+
+/**
+ * Decodes one connection's stream and keeps a rolling window of its events.
+ * Strings are resolved as they arrive, so a Reset from the profiler only
+ * throws away the id mapping, not events already in the window.
+ */
+class Collector {
+  private:
+    const Options &mOptions;
+
+    std::string mPending; // received bytes not yet decoded
+    bool mHasHeader{false};
+    uint64_t mTicksPerSecond{0};
+    uint64_t mOriginTicks{0};
+    uint64_t mWindowTicks{0};
+    uint64_t mFrameThresholdTicks{0};
+
+    // NOTE: Node-based, so the pointers handed to TraceWriter stay valid
+    std::unordered_set<std::string> mInterned;
+    std::vector<const char *> mStrings;
+    std::map<uint64_t, uint64_t> mLastStart;
+
+    std::deque<StoredEvent> mEvents;
+    std::vector<TrackName> mNames;
+    uint64_t mNewestTicks{0};
+    uint64_t mLastFrameTicks{0};
+    bool mHasFrame{false};
+    uint32_t mSlowFrames{0};    // since the last dump
+    uint64_t mSlowDumpTicks{0}; // dump once the window reaches this
+    uint64_t mDroppedBytes{0};
+    uint32_t mDumpCount{0};
+    bool mIsMalformed{false};
+
+    const char *string(uint64_t id) const {
+        return (id < mStrings.size()) ? mStrings[id] : "<unknown>";
+    };
+
+    bool decodeRecord(GTFO::Format::Reader &reader);
+    void store(const StoredEvent &event);
+    void storeName(const TrackName &name);
+
+  public:
+    explicit Collector(const Options &options) : mOptions(options){};
+
+    // Returns false once the stream turns out to be malformed
+    bool receive(const char *data, std::size_t size);
+    void dump(const char *reason);
+};
+
+bool Collector::receive(const char *data, std::size_t size) {
+    mPending.append(data, size);
+    GTFO::Format::Reader reader(mPending.data(), mPending.size());
+
+    if (!mHasHeader) {
+        std::string magic;
+        uint64_t version, reserved;
+        if (!reader.readBytes(magic, sizeof(GTFO::Format::Magic)) ||
+            !reader.readFixed(version, 4) || !reader.readFixed(reserved, 4) ||
+            !reader.readFixed(mTicksPerSecond, 8) ||
+            !reader.readFixed(mOriginTicks, 8))
+            return true;
+
+        if (std::memcmp(magic.data(), GTFO::Format::Magic, magic.size()) !=
+                0 ||
+            version != GTFO::Format::Version || mTicksPerSecond == 0) {
+            std::fprintf(stderr, "Not a GTFO live stream\n");
+            return false;
+        }
+
+        mHasHeader = true;
+        mWindowTicks = static_cast<uint64_t>(mOptions.windowSeconds *
+                                             mTicksPerSecond);
+        mFrameThresholdTicks = static_cast<uint64_t>(
+            mOptions.frameThresholdMs * 1e-3 * mTicksPerSecond);
+        std::printf("Session started, %.1f s window\n",
+                    mOptions.windowSeconds);
+    }
+
+    // NOTE: A record split across reads is decoded again from its tag once
+    // the rest has arrived
+    std::size_t consumed = reader.offset();
+    while (!reader.isAtEnd()) {
+        if (!decodeRecord(reader))
+            break;
+        consumed = reader.offset();
+
+        if (mSlowFrames != 0 && mNewestTicks >= mSlowDumpTicks)
+            dump(mSlowFrames == 1 ? "slow frame" : "slow frames");
+    }
+
+    mPending.erase(0, consumed);
+    return !mIsMalformed;
+};
+
+bool Collector::decodeRecord(GTFO::Format::Reader &reader) {
+    uint8_t tag;
+    uint64_t fields[6];
+    if (!reader.readByte(tag))
+        return false;
+
+    switch (tag) {
+    case GTFO::Format::TagString: {
+        uint64_t id, length;
+        std::string value;
+        if (!reader.readVarint(id) || !reader.readVarint(length) ||
+            !reader.readBytes(value, length))
+            return false;
+
+        if (id >= mStrings.size())
+            mStrings.resize(id + 1, "<unknown>");
+        mStrings[id] = mInterned.insert(value).first->c_str();
+        return true;
+    }
+
+    case GTFO::Format::TagComplete:
+    case GTFO::Format::TagInstant:
+    case GTFO::Format::TagCounter:
+    case GTFO::Format::TagFrame:
+    case GTFO::Format::TagSample: {
+        for (int i = 0; i < 5; i++)
+            if (!reader.readVarint(fields[i]))
+                return false;
+
+        StoredEvent event;
+        event.processId = static_cast<uint32_t>(fields[0]);
+        event.threadId = static_cast<uint32_t>(fields[1]);
+        event.result.name = string(fields[2]);
+        event.result.category = string(fields[3]);
+        event.result.end = 0;
+        event.result.type = GTFO::EventType::Instant;
+        event.result.allocations = 0;
+
+        bool isRead = true;
+        uint64_t depth, frame;
+        switch (tag) {
+        case GTFO::Format::TagComplete:
+            event.result.type = GTFO::EventType::Complete;
+            isRead = reader.readVarint(event.result.end) &&
+                     reader.readVarint(fields[5]);
+            event.result.allocations = static_cast<uint32_t>(fields[5]);
+            break;
+        case GTFO::Format::TagInstant:
+            event.result.type = GTFO::EventType::Instant;
+            break;
+        case GTFO::Format::TagCounter:
+            event.result.type = GTFO::EventType::Counter;
+            isRead = reader.readFixed(event.result.end, 8);
+            break;
+        case GTFO::Format::TagFrame:
+            event.result.type = GTFO::EventType::Frame;
+            isRead = reader.readVarint(event.result.end);
+            break;
+        default:
+            // Live sessions are not sampled, skipped for completeness
+            isRead = reader.readVarint(depth);
+            for (uint64_t i = 0; isRead && i < depth; i++)
+                isRead = reader.readVarint(frame);
+            break;
+        }
+        if (!isRead)
+            return false;
+
+        uint64_t &last =
+            mLastStart[(static_cast<uint64_t>(event.processId) << 32) |
+                       event.threadId];
+        last += GTFO::Format::unzigzag(fields[4]);
+        event.result.start = mOriginTicks + last;
+        if (event.result.type == GTFO::EventType::Complete)
+            event.result.end += event.result.start;
+
+        if (tag == GTFO::Format::TagSample)
+            return true;
+
+        if (event.result.type == GTFO::EventType::Frame) {
+            const bool isSlowFrame =
+                mHasFrame && mFrameThresholdTicks != 0 &&
+                event.result.start - mLastFrameTicks > mFrameThresholdTicks;
+            if (isSlowFrame && mSlowFrames++ == 0)
+                mSlowDumpTicks = event.result.start + mWindowTicks / 2;
+            mLastFrameTicks = event.result.start;
+            mHasFrame = true;
+        }
+
+        store(event);
+        return true;
+    }
+
+    case GTFO::Format::TagMetadata:
+    case GTFO::Format::TagModule:
+        for (int i = 0; i < (tag == GTFO::Format::TagMetadata ? 5 : 4); i++)
+            if (!reader.readVarint(fields[i]))
+                return false;
+        return true;
+
+    case GTFO::Format::TagName: {
+        for (int i = 0; i < 4; i++)
+            if (!reader.readVarint(fields[i]))
+                return false;
+
+        TrackName name = {string(fields[0]),
+                          static_cast<uint32_t>(fields[1]),
+                          static_cast<uint32_t>(fields[2]), string(fields[3])};
+        storeName(name);
+        return true;
+    }
+
+    case GTFO::Format::TagReset:
+        if (!reader.readVarint(mDroppedBytes))
+            return false;
+
+        std::fprintf(stderr, "Collector fell behind, %llu bytes dropped so "
+                             "far\n",
+                     static_cast<unsigned long long>(mDroppedBytes));
+        mStrings.clear();
+        mLastStart.clear();
+        return true;
+
+    case GTFO::Format::TagEnd:
+        std::printf("Session ended\n");
+        return true;
+
+    default:
+        std::fprintf(stderr, "Unknown record tag %u\n", tag);
+        mIsMalformed = true;
+        return false;
+    }
+};
+
+// Scopes arrive when they end, so the window is trimmed by the newest
+// timestamp seen rather than by the front event alone
+void Collector::store(const StoredEvent &event) {
+    mEvents.push_back(event);
+    if (event.result.start > mNewestTicks)
+        mNewestTicks = event.result.start;
+
+    while (!mEvents.empty() &&
+           mEvents.front().result.start + mWindowTicks < mNewestTicks)
+        mEvents.pop_front();
+};
+
+// The profiler repeats every name after a Reset, so a track keeps one entry
+void Collector::storeName(const TrackName &name) {
+    for (std::size_t i = 0; i < mNames.size(); i++) {
+        if (mNames[i].name == name.name &&
+            mNames[i].processId == name.processId &&
+            mNames[i].threadId == name.threadId) {
+            mNames[i].value = name.value;
+            return;
+        }
+    }
+    mNames.push_back(name);
+};
+
+void Collector::dump(const char *reason) {
+    const uint32_t slowFrames = mSlowFrames;
+    mSlowFrames = 0;
+    if (!mHasHeader || mEvents.empty())
+        return;
+
+    char filePath[512];
+    std::snprintf(filePath, sizeof(filePath), "%s_%u.gtfo",
+                  mOptions.outputPrefix.c_str(), mDumpCount++);
+
+    GTFO::TraceWriter writer;
+    if (!writer.open(filePath, mOriginTicks, mTicksPerSecond,
+                     GTFO::TraceFormat::Binary)) {
+        std::fprintf(stderr, "Failed to write %s\n", filePath);
+        return;
+    }
+
+    for (std::size_t i = 0; i < mEvents.size(); i++)
+        writer.writeEvent(mEvents[i].result, mEvents[i].processId,
+                          mEvents[i].threadId);
+    for (std::size_t i = 0; i < mNames.size(); i++)
+        writer.writeName(mNames[i].name, mNames[i].processId,
+                         mNames[i].threadId, mNames[i].value);
+    if (mDroppedBytes != 0)
+        writer.writeMetadata("gtfo_dropped_bytes", 0, 0, "count",
+                             mDroppedBytes);
+    writer.close();
+
+    if (slowFrames > 1)
+        std::printf("Wrote %zu events to %s (%s, %u in this window)\n",
+                    mEvents.size(), filePath, reason, slowFrames);
+    else
+        std::printf("Wrote %zu events to %s (%s)\n", mEvents.size(),
+                    filePath, reason);
+};
+
+int listenSocket(const char *socketPath) {
+    sockaddr_un address;
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (std::strlen(socketPath) >= sizeof(address.sun_path)) {
+        std::fprintf(stderr, "Socket path %s is too long\n", socketPath);
+        return -1;
+    }
+    std::strcpy(address.sun_path, socketPath);
+
+    const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0)
+        return -1;
+
+    unlink(socketPath);
+    if (bind(fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) !=
+            0 ||
+        listen(fd, 1) != 0) {
+        std::fprintf(stderr, "Failed to listen on %s: %s\n", socketPath,
+                     std::strerror(errno));
+        close(fd);
+        return -1;
+    }
+    return fd;
+};
+
+// Serves one session at a time until SIGINT or SIGTERM
+void serve(int listener, const Options &options) {
+    while (!sIsStopRequested) {
+        pollfd waiting = {listener, POLLIN, 0};
+        if (poll(&waiting, 1, 100) <= 0)
+            continue;
+
+        const int connection = accept(listener, nullptr, nullptr);
+        if (connection < 0)
+            continue;
+
+        Collector collector(options);
+        char data[1 << 16];
+        while (!sIsStopRequested) {
+            if (sIsDumpRequested) {
+                sIsDumpRequested = 0;
+                collector.dump("requested");
+            }
+
+            pollfd reading = {connection, POLLIN, 0};
+            if (poll(&reading, 1, 100) <= 0)
+                continue;
+
+            const ssize_t size = recv(connection, data, sizeof(data), 0);
+            if (size <= 0 ||
+                !collector.receive(data, static_cast<std::size_t>(size)))
+                break;
+        }
+
+        close(connection);
+        collector.dump("session ended");
+    }
+};
+
+void printUsage() {
+    std::fprintf(stderr, "Usage: gtfo_collector <socket path> "
+                         "[--window seconds] [--frame-threshold ms] "
+                         "[--output prefix]\n");
+};
+} // namespace
+
+int main(int argc, char *argv[]) {
+    if (argc < 2) {
+        printUsage();
+        return EXIT_FAILURE;
+    }
+
+    Options options;
+    options.socketPath = argv[1];
+    for (int i = 2; i < argc; i++) {
+        if (std::strcmp(argv[i], "--window") == 0 && i + 1 < argc) {
+            options.windowSeconds = std::atof(argv[++i]);
+        } else if (std::strcmp(argv[i], "--frame-threshold") == 0 &&
+                   i + 1 < argc) {
+            options.frameThresholdMs = std::atof(argv[++i]);
+        } else if (std::strcmp(argv[i], "--output") == 0 && i + 1 < argc) {
+            options.outputPrefix = argv[++i];
+        } else {
+            printUsage();
+            return EXIT_FAILURE;
+        }
+    }
+
+    const int listener = listenSocket(options.socketPath);
+    if (listener < 0)
+        return EXIT_FAILURE;
+
+    std::signal(SIGUSR1, onDumpSignal);
+    std::signal(SIGINT, onStopSignal);
+    std::signal(SIGTERM, onStopSignal);
+
+    std::printf("Listening on %s (pid %d), kill -USR1 to dump the window\n",
+                options.socketPath, static_cast<int>(getpid()));
+    std::fflush(stdout);
+    serve(listener, options);
+
+    close(listener);
+    unlink(options.socketPath);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,880 @@
+/**
+ * gtfo_convert
+ * Converts a binary .gtfo trace into Chrome trace JSON or a Perfetto
+ * protobuf trace. Stack samples are symbolized with addr2line from the
+ * module map recorded in the trace, so it has to run on the machine (or
+ * with the same binaries) the trace was taken with.
+ *
+ * Usage: gtfo_convert <input.gtfo> <output> [--format chrome|perfetto]
+ */
+#include "gtfo_profiler.h"
+#include "gtfo_trace_format.h"
+#include "gtfo_trace_writer.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#if defined(_WIN32)
+#define popen _popen
+#define pclose _pclose
+#endif
+
+namespace {
+struct Event {
+    GTFO::EventType type;
+    uint32_t processId;
+    uint32_t threadId;
+    uint64_t nameId;
+    uint64_t categoryId;
+    uint64_t start;   // ticks since the session origin
+    uint64_t payload; // duration, counter value bits or frame number
+    uint64_t allocations;
+    uint64_t stackId; // symbolized samples: index into Trace::stacks + 1
+};
+
+struct SampleEvent {
+    uint32_t processId;
+    uint32_t threadId;
+    uint64_t start;
+    std::size_t firstFrame; // into Trace::frames, innermost first
+    uint32_t depth;
+};
+
+struct Module {
+    uint64_t pathId;
+    uint64_t start;
+    uint64_t end;
+    uint64_t offset;
+};
+
+struct MetadataEvent {
+    uint64_t nameId;
+    uint32_t processId;
+    uint32_t threadId;
+    uint64_t argNameId;
+    uint64_t value;
+};
+
+struct NameEvent {
+    uint64_t nameId;
+    uint32_t processId;
+    uint32_t threadId;
+    uint64_t valueId;
+};
+
+uint64_t trackKey(uint32_t processId, uint32_t threadId) {
+    return (static_cast<uint64_t>(processId) << 32) | threadId;
+};
+
+struct Trace {
+    uint64_t ticksPerSecond{0};
+    uint64_t originTicks{0};
+    bool isComplete{false};
+
+    // NOTE: deque keeps c_str() pointers stable while the table grows
+    std::deque<std::string> strings;
+    std::vector<Event> events;
+    std::vector<MetadataEvent> metadata;
+    std::vector<NameEvent> names;
+
+    std::vector<SampleEvent> samples;
+    std::vector<uint64_t> frames;
+    std::vector<Module> modules;
+    std::vector<std::string> stacks;
+
+    const char *string(uint64_t id) const {
+        return (id < strings.size()) ? strings[id].c_str() : "<unknown>";
+    };
+};
+
+bool readTrace(const char *filePath, Trace &trace) {
+    std::ifstream file(filePath, std::ios::binary);
+    if (!file.is_open()) {
+        std::fprintf(stderr, "Failed to open %s\n", filePath);
+        return false;
+    }
+
+    const std::string data((std::istreambuf_iterator<char>(file)),
+                           std::istreambuf_iterator<char>());
+    GTFO::Format::Reader reader(data.data(), data.size());
+
+    std::string magic;
+    uint64_t version, reserved;
+    if (!reader.readBytes(magic, sizeof(GTFO::Format::Magic)) ||
+        std::memcmp(magic.data(), GTFO::Format::Magic, magic.size()) != 0 ||
+        !reader.readFixed(version, 4) || !reader.readFixed(reserved, 4) ||
+        !reader.readFixed(trace.ticksPerSecond, 8) ||
+        !reader.readFixed(trace.originTicks, 8)) {
+        std::fprintf(stderr, "%s is not a GTFO binary trace\n", filePath);
+        return false;
+    }
+
+    if (version != GTFO::Format::Version) {
+        std::fprintf(stderr, "Unsupported trace version %llu\n",
+                     static_cast<unsigned long long>(version));
+        return false;
+    }
+
+    std::map<uint64_t, uint64_t> lastStart;
+    uint8_t tag;
+    while (reader.readByte(tag)) {
+        uint64_t fields[6];
+        switch (tag) {
+        case GTFO::Format::TagString: {
+            std::string value;
+            if (!reader.readVarint(fields[0]) ||
+                !reader.readVarint(fields[1]) ||
+                !reader.readBytes(value, fields[1]))
+                return true;
+            if (fields[0] >= trace.strings.size())
+                trace.strings.resize(fields[0] + 1);
+            trace.strings[fields[0]] = value;
+            break;
+        }
+
+        case GTFO::Format::TagComplete:
+        case GTFO::Format::TagInstant:
+        case GTFO::Format::TagCounter:
+        case GTFO::Format::TagFrame: {
+            for (int i = 0; i < 5; i++)
+                if (!reader.readVarint(fields[i]))
+                    return true;
+
+            Event event;
+            event.processId = static_cast<uint32_t>(fields[0]);
+            event.threadId = static_cast<uint32_t>(fields[1]);
+            event.nameId = fields[2];
+            event.categoryId = fields[3];
+            event.payload = 0;
+            event.allocations = 0;
+            event.stackId = 0;
+
+            bool isRead = true;
+            switch (tag) {
+            case GTFO::Format::TagComplete:
+                event.type = GTFO::EventType::Complete;
+                isRead = reader.readVarint(event.payload) &&
+                         reader.readVarint(event.allocations);
+                break;
+            case GTFO::Format::TagInstant:
+                event.type = GTFO::EventType::Instant;
+                break;
+            case GTFO::Format::TagCounter:
+                event.type = GTFO::EventType::Counter;
+                isRead = reader.readFixed(event.payload, 8);
+                break;
+            default:
+                event.type = GTFO::EventType::Frame;
+                isRead = reader.readVarint(event.payload);
+                break;
+            }
+            if (!isRead)
+                return true;
+
+            uint64_t &last =
+                lastStart[trackKey(event.processId, event.threadId)];
+            event.start = last + GTFO::Format::unzigzag(fields[4]);
+            last = event.start;
+            trace.events.push_back(event);
+            break;
+        }
+
+        case GTFO::Format::TagSample: {
+            uint64_t depth;
+            for (int i = 0; i < 5; i++)
+                if (!reader.readVarint(fields[i]))
+                    return true;
+            if (!reader.readVarint(depth) || depth > GTFO::MaxStackDepth)
+                return true;
+
+            SampleEvent sample;
+            sample.processId = static_cast<uint32_t>(fields[0]);
+            sample.threadId = static_cast<uint32_t>(fields[1]);
+            sample.firstFrame = trace.frames.size();
+            sample.depth = static_cast<uint32_t>(depth);
+
+            uint64_t frame = 0;
+            for (uint64_t i = 0; i < depth; i++) {
+                uint64_t delta;
+                if (!reader.readVarint(delta)) {
+                    trace.frames.resize(sample.firstFrame);
+                    return true;
+                }
+                frame += static_cast<uint64_t>(GTFO::Format::unzigzag(delta));
+                trace.frames.push_back(frame);
+            }
+
+            uint64_t &last =
+                lastStart[trackKey(sample.processId, sample.threadId)];
+            sample.start = last + GTFO::Format::unzigzag(fields[4]);
+            last = sample.start;
+            trace.samples.push_back(sample);
+            break;
+        }
+
+        case GTFO::Format::TagModule: {
+            for (int i = 0; i < 4; i++)
+                if (!reader.readVarint(fields[i]))
+                    return true;
+
+            Module module;
+            module.pathId = fields[0];
+            module.start = fields[1];
+            module.end = fields[2];
+            module.offset = fields[3];
+            trace.modules.push_back(module);
+            break;
+        }
+
+        case GTFO::Format::TagMetadata: {
+            for (int i = 0; i < 5; i++)
+                if (!reader.readVarint(fields[i]))
+                    return true;
+
+            MetadataEvent event;
+            event.nameId = fields[0];
+            event.processId = static_cast<uint32_t>(fields[1]);
+            event.threadId = static_cast<uint32_t>(fields[2]);
+            event.argNameId = fields[3];
+            event.value = fields[4];
+            trace.metadata.push_back(event);
+            break;
+        }
+
+        case GTFO::Format::TagName: {
+            for (int i = 0; i < 4; i++)
+                if (!reader.readVarint(fields[i]))
+                    return true;
+
+            NameEvent event;
+            event.nameId = fields[0];
+            event.processId = static_cast<uint32_t>(fields[1]);
+            event.threadId = static_cast<uint32_t>(fields[2]);
+            event.valueId = fields[3];
+            trace.names.push_back(event);
+            break;
+        }
+
+        case GTFO::Format::TagEnd:
+            trace.isComplete = true;
+            return true;
+
+        default:
+            std::fprintf(stderr, "Unknown record tag %u, stopping\n", tag);
+            return true;
+        }
+    }
+
+    return true;
+};
+
+// NOTE: Program headers of a 64-bit little-endian ELF file, enough to turn
+// the file offsets of /proc/self/maps into the addresses addr2line expects
+struct LoadSegment {
+    uint64_t offset;
+    uint64_t fileSize;
+    uint64_t address;
+};
+
+uint64_t readLittleEndian(const unsigned char *bytes, std::size_t size) {
+    uint64_t value = 0;
+    for (std::size_t i = size; i-- > 0;)
+        value = (value << 8) | bytes[i];
+    return value;
+};
+
+std::vector<LoadSegment> readLoadSegments(const std::string &path) {
+    std::vector<LoadSegment> segments;
+    std::ifstream file(path.c_str(), std::ios::binary);
+
+    unsigned char header[64];
+    if (!file.read(reinterpret_cast<char *>(header), sizeof(header)) ||
+        std::memcmp(header, "\x7f"
+                            "ELF",
+                    4) != 0 ||
+        header[4] != 2 || header[5] != 1)
+        return segments;
+
+    const uint64_t tableOffset = readLittleEndian(header + 0x20, 8);
+    const uint64_t entrySize = readLittleEndian(header + 0x36, 2);
+    const uint64_t entryCount = readLittleEndian(header + 0x38, 2);
+    if (entrySize < 56)
+        return segments;
+
+    for (uint64_t i = 0; i < entryCount; i++) {
+        unsigned char entry[56];
+        file.seekg(static_cast<std::streamoff>(tableOffset + i * entrySize));
+        if (!file.read(reinterpret_cast<char *>(entry), sizeof(entry)))
+            break;
+
+        const uint32_t PT_LOAD = 1;
+        if (readLittleEndian(entry, 4) != PT_LOAD)
+            continue;
+
+        LoadSegment segment;
+        segment.offset = readLittleEndian(entry + 8, 8);
+        segment.address = readLittleEndian(entry + 16, 8);
+        segment.fileSize = readLittleEndian(entry + 32, 8);
+        segments.push_back(segment);
+    }
+    return segments;
+};
+
+std::string hexAddress(uint64_t address) {
+    char text[32];
+    std::snprintf(text, sizeof(text), "0x%llx",
+                  static_cast<unsigned long long>(address));
+    return text;
+};
+
+// Resolves addresses of one module through addr2line, in batches to keep
+// the command line short. Unresolved entries stay empty.
+void runAddr2line(const std::string &path,
+                  const std::vector<uint64_t> &addresses,
+                  std::vector<std::string> &functions) {
+    const std::size_t BatchSize = 200;
+    functions.assign(addresses.size(), std::string());
+
+    std::string quotedPath = "'";
+    for (std::size_t i = 0; i < path.size(); i++)
+        quotedPath += (path[i] == '\'') ? std::string("'\\''")
+                                        : std::string(1, path[i]);
+    quotedPath += "'";
+
+    for (std::size_t begin = 0; begin < addresses.size(); begin += BatchSize) {
+        const std::size_t end =
+            std::min(addresses.size(), begin + BatchSize);
+
+        std::string command = "addr2line -f -C -e " + quotedPath;
+        for (std::size_t i = begin; i < end; i++)
+            command += " " + hexAddress(addresses[i]);
+
+        std::FILE *pipe = popen(command.c_str(), "r");
+        if (pipe == nullptr)
+            return;
+
+        // NOTE: Two lines per address, the function and its file:line
+        char line[4096];
+        for (std::size_t i = begin; i < end; i++) {
+            if (std::fgets(line, sizeof(line), pipe) == nullptr)
+                break;
+            std::string function(line);
+            function.erase(function.find_last_not_of("\r\n") + 1);
+            if (function != "??")
+                functions[i] = function;
+
+            if (std::fgets(line, sizeof(line), pipe) == nullptr)
+                break;
+        }
+        pclose(pipe);
+    }
+};
+
+// Turns the raw samples into instant events on their thread's track,
+// named after the innermost function and carrying the whole stack
+void symbolizeSamples(Trace &trace) {
+    std::vector<std::size_t> moduleOrder(trace.modules.size());
+    for (std::size_t i = 0; i < moduleOrder.size(); i++)
+        moduleOrder[i] = i;
+    std::sort(moduleOrder.begin(), moduleOrder.end(),
+              [&trace](std::size_t a, std::size_t b) {
+                  return trace.modules[a].start < trace.modules[b].start;
+              });
+
+    const auto findModule = [&trace,
+                             &moduleOrder](uint64_t address) -> std::size_t {
+        std::size_t low = 0, high = moduleOrder.size();
+        while (low < high) {
+            const std::size_t middle = (low + high) / 2;
+            if (trace.modules[moduleOrder[middle]].start <= address)
+                low = middle + 1;
+            else
+                high = middle;
+        }
+        if (low == 0)
+            return trace.modules.size();
+        const Module &module = trace.modules[moduleOrder[low - 1]];
+        return address < module.end ? moduleOrder[low - 1]
+                                    : trace.modules.size();
+    };
+
+    // NOTE: Return addresses point past the call, one byte back lands in
+    // the calling line instead of the next one
+    std::map<std::size_t, std::set<uint64_t>> addressesByModule;
+    std::map<uint64_t, std::string> symbols;
+    for (std::size_t i = 0; i < trace.samples.size(); i++) {
+        const SampleEvent &sample = trace.samples[i];
+        for (uint32_t depth = 0; depth < sample.depth; depth++) {
+            uint64_t address = trace.frames[sample.firstFrame + depth];
+            if (depth != 0)
+                address--;
+            trace.frames[sample.firstFrame + depth] = address;
+
+            const std::size_t module = findModule(address);
+            if (module == trace.modules.size())
+                symbols[address] = hexAddress(address);
+            else
+                addressesByModule[module].insert(address);
+        }
+    }
+
+    for (std::map<std::size_t, std::set<uint64_t>>::const_iterator it =
+             addressesByModule.begin();
+         it != addressesByModule.end(); ++it) {
+        const Module &module = trace.modules[it->first];
+        const std::string path = trace.string(module.pathId);
+        const std::vector<LoadSegment> segments = readLoadSegments(path);
+
+        std::vector<uint64_t> addresses(it->second.begin(), it->second.end());
+        std::vector<uint64_t> fileOffsets(addresses.size());
+        std::vector<uint64_t> fileAddresses(addresses.size());
+        for (std::size_t i = 0; i < addresses.size(); i++) {
+            fileOffsets[i] = addresses[i] - module.start + module.offset;
+            fileAddresses[i] = fileOffsets[i];
+            for (std::size_t s = 0; s < segments.size(); s++) {
+                const LoadSegment &segment = segments[s];
+                if (fileOffsets[i] >= segment.offset &&
+                    fileOffsets[i] < segment.offset + segment.fileSize) {
+                    fileAddresses[i] =
+                        fileOffsets[i] - segment.offset + segment.address;
+                    break;
+                }
+            }
+        }
+
+        std::vector<std::string> functions;
+        runAddr2line(path, fileAddresses, functions);
+
+        const std::string baseName = path.substr(path.find_last_of('/') + 1);
+        for (std::size_t i = 0; i < addresses.size(); i++)
+            symbols[addresses[i]] =
+                functions[i].empty()
+                    ? baseName + "+" + hexAddress(fileOffsets[i])
+                    : functions[i];
+    }
+
+    const uint64_t categoryId = trace.strings.size();
+    trace.strings.push_back("sample");
+
+    std::map<std::string, uint64_t> nameIds;
+    for (std::size_t i = 0; i < trace.samples.size(); i++) {
+        const SampleEvent &sample = trace.samples[i];
+        if (sample.depth == 0)
+            continue;
+
+        std::string stack;
+        for (uint32_t depth = 0; depth < sample.depth; depth++) {
+            if (depth != 0)
+                stack += "\n";
+            stack += symbols[trace.frames[sample.firstFrame + depth]];
+        }
+
+        const std::string &leaf = symbols[trace.frames[sample.firstFrame]];
+        std::map<std::string, uint64_t>::iterator name = nameIds.find(leaf);
+        if (name == nameIds.end()) {
+            name = nameIds.insert(std::make_pair(leaf, trace.strings.size()))
+                       .first;
+            trace.strings.push_back(leaf);
+        }
+
+        trace.stacks.push_back(stack);
+
+        Event event;
+        event.type = GTFO::EventType::Instant;
+        event.processId = sample.processId;
+        event.threadId = sample.threadId;
+        event.nameId = name->second;
+        event.categoryId = categoryId;
+        event.start = sample.start;
+        event.payload = 0;
+        event.allocations = 0;
+        event.stackId = trace.stacks.size();
+        trace.events.push_back(event);
+    }
+};
+
+const uint64_t NanosecondsPerSecond = 1000000000;
+
+uint64_t toNanoseconds(const Trace &trace, uint64_t ticks) {
+    if (trace.ticksPerSecond == NanosecondsPerSecond)
+        return ticks;
+    return static_cast<uint64_t>(static_cast<double>(ticks) *
+                                 NanosecondsPerSecond / trace.ticksPerSecond);
+};
+
+bool writeChrome(const Trace &trace, const char *filePath) {
+    GTFO::TraceWriter writer;
+    if (!writer.open(filePath, 0, trace.ticksPerSecond,
+                     GTFO::TraceFormat::ChromeJSON))
+        return false;
+
+    for (std::size_t i = 0; i < trace.events.size(); i++) {
+        const Event &event = trace.events[i];
+        if (event.stackId != 0) {
+            writer.writeSymbolizedSample(trace.string(event.nameId),
+                                         trace.stacks[event.stackId - 1],
+                                         event.processId, event.threadId,
+                                         event.start);
+            continue;
+        }
+
+        GTFO::ProfileResult result;
+        result.name = trace.string(event.nameId);
+        result.category = trace.string(event.categoryId);
+        result.start = event.start;
+        result.end = (event.type == GTFO::EventType::Complete)
+                         ? event.start + event.payload
+                         : event.payload;
+        result.type = event.type;
+        result.allocations = static_cast<uint32_t>(event.allocations);
+        writer.writeEvent(result, event.processId, event.threadId);
+    }
+
+    for (std::size_t i = 0; i < trace.metadata.size(); i++) {
+        const MetadataEvent &event = trace.metadata[i];
+        writer.writeMetadata(trace.string(event.nameId), event.processId,
+                             event.threadId, trace.string(event.argNameId),
+                             event.value);
+    }
+
+    for (std::size_t i = 0; i < trace.names.size(); i++) {
+        const NameEvent &event = trace.names[i];
+        writer.writeName(trace.string(event.nameId), event.processId,
+                         event.threadId, trace.string(event.valueId));
+    }
+
+    writer.close();
+    return true;
+};
+
+// NOTE: Minimal protobuf encoding of perfetto.protos.Trace
+namespace Perfetto {
+enum WireType { Varint = 0, Fixed64 = 1, LengthDelimited = 2 };
+
+// Field numbers from perfetto/protos/perfetto/trace/
+const uint32_t TracePacketField = 1;           // Trace.packet
+const uint32_t TimestampField = 8;             // TracePacket.timestamp
+const uint32_t SequenceIdField = 10;           // .trusted_packet_sequence_id
+const uint32_t TrackEventField = 11;           // TracePacket.track_event
+const uint32_t TrackDescriptorField = 60;      // TracePacket.track_descriptor
+const uint32_t TrackUuidField = 1;             // TrackDescriptor.uuid
+const uint32_t TrackNameField = 2;             // TrackDescriptor.name
+const uint32_t TrackProcessField = 3;          // TrackDescriptor.process
+const uint32_t TrackThreadField = 4;           // TrackDescriptor.thread
+const uint32_t TrackParentField = 5;           // TrackDescriptor.parent_uuid
+const uint32_t TrackCounterField = 8;          // TrackDescriptor.counter
+const uint32_t ProcessPidField = 1;            // ProcessDescriptor.pid
+const uint32_t ProcessNameField = 6;           // .process_name
+const uint32_t ThreadPidField = 1;             // ThreadDescriptor.pid
+const uint32_t ThreadTidField = 2;             // ThreadDescriptor.tid
+const uint32_t ThreadNameField = 5;            // ThreadDescriptor.thread_name
+const uint32_t EventAnnotationField = 4;       // TrackEvent.debug_annotations
+const uint32_t EventTypeField = 9;             // TrackEvent.type
+const uint32_t EventTrackUuidField = 11;       // TrackEvent.track_uuid
+const uint32_t EventCategoriesField = 22;      // TrackEvent.categories
+const uint32_t EventNameField = 23;            // TrackEvent.name
+const uint32_t EventDoubleValueField = 44;     // .double_counter_value
+const uint32_t AnnotationUintField = 3;        // DebugAnnotation.uint_value
+const uint32_t AnnotationStringField = 6;      // .string_value
+const uint32_t AnnotationNameField = 10;       // DebugAnnotation.name
+
+const uint64_t SliceBegin = 1;
+const uint64_t SliceEnd = 2;
+const uint64_t Instant = 3;
+const uint64_t Counter = 4;
+
+const uint64_t SequenceId = 1;
+
+void appendTag(std::string &out, uint32_t field, WireType type) {
+    GTFO::Format::appendVarint(out, (static_cast<uint64_t>(field) << 3) | type);
+};
+
+void appendVarintField(std::string &out, uint32_t field, uint64_t value) {
+    appendTag(out, field, Varint);
+    GTFO::Format::appendVarint(out, value);
+};
+
+void appendDoubleField(std::string &out, uint32_t field, double value) {
+    appendTag(out, field, Fixed64);
+    GTFO::Format::appendFixed64(out, GTFO::counterBits(value));
+};
+
+void appendBytesField(std::string &out, uint32_t field,
+                      const std::string &value) {
+    appendTag(out, field, LengthDelimited);
+    GTFO::Format::appendVarint(out, value.size());
+    out += value;
+};
+
+// NOTE: Perfetto treats pid 0 as the kernel swapper, so every GTFO process
+// id is shifted by one
+uint64_t perfettoPid(uint32_t processId) {
+    return static_cast<uint64_t>(processId) + 1;
+};
+
+uint64_t threadTrackUuid(uint64_t key) { return (1ull << 63) | key; };
+uint64_t processTrackUuid(uint32_t processId) {
+    return (1ull << 62) | processId;
+};
+uint64_t counterTrackUuid(std::size_t index) { return (1ull << 61) | index; };
+
+void appendPacket(std::string &trace, const std::string &packet) {
+    appendBytesField(trace, TracePacketField, packet);
+};
+
+enum MarkerKind { MarkerEnd, MarkerInstant, MarkerBegin };
+
+struct SliceMarker {
+    uint64_t timestamp;
+    uint64_t duration; // of the slice this marker belongs to
+    MarkerKind kind;
+    const Event *event;
+};
+
+// Ends before instants before begins at equal timestamps, outer slices open
+// first and close last, so every track nests correctly
+bool markerOrder(const SliceMarker &a, const SliceMarker &b) {
+    if (a.timestamp != b.timestamp)
+        return a.timestamp < b.timestamp;
+    if (a.kind != b.kind)
+        return a.kind < b.kind;
+    return (a.kind == MarkerBegin) ? (a.duration > b.duration)
+                                   : (a.duration < b.duration);
+};
+
+void appendTrackDescriptor(std::string &out, const std::string &descriptor) {
+    std::string packet;
+    appendBytesField(packet, TrackDescriptorField, descriptor);
+    appendPacket(out, packet);
+};
+
+void appendTrackEvent(std::string &out, uint64_t timestamp,
+                      const std::string &event) {
+    std::string packet;
+    appendVarintField(packet, TimestampField, timestamp);
+    appendVarintField(packet, SequenceIdField, SequenceId);
+    appendBytesField(packet, TrackEventField, event);
+    appendPacket(out, packet);
+};
+} // namespace Perfetto
+
+bool writePerfetto(const Trace &trace, const char *filePath) {
+    using namespace Perfetto;
+
+    // NOTE: Counters get one track per process and name, everything else
+    // is placed on its thread's track
+    std::map<uint64_t, std::vector<SliceMarker>> tracks;
+    std::map<std::pair<uint32_t, std::string>, std::vector<const Event *>>
+        counters;
+    for (std::size_t i = 0; i < trace.events.size(); i++) {
+        const Event &event = trace.events[i];
+        if (event.type == GTFO::EventType::Counter) {
+            counters[std::make_pair(event.processId,
+                                    std::string(trace.string(event.nameId)))]
+                .push_back(&event);
+            continue;
+        }
+
+        std::vector<SliceMarker> &markers =
+            tracks[trackKey(event.processId, event.threadId)];
+        const uint64_t begin =
+            toNanoseconds(trace, trace.originTicks + event.start);
+
+        if (event.type != GTFO::EventType::Complete) {
+            SliceMarker marker = {begin, 0, MarkerInstant, &event};
+            markers.push_back(marker);
+            continue;
+        }
+
+        const uint64_t end = toNanoseconds(
+            trace, trace.originTicks + event.start + event.payload);
+        SliceMarker marker = {begin, event.payload, MarkerBegin, &event};
+        markers.push_back(marker);
+        marker.timestamp = end;
+        marker.kind = MarkerEnd;
+        markers.push_back(marker);
+    }
+
+    std::map<uint64_t, const char *> threadNames;
+    std::map<uint32_t, const char *> processNames;
+    for (std::size_t i = 0; i < trace.names.size(); i++) {
+        const NameEvent &name = trace.names[i];
+        const std::string kind = trace.string(name.nameId);
+        if (kind == "thread_name")
+            threadNames[trackKey(name.processId, name.threadId)] =
+                trace.string(name.valueId);
+        else if (kind == "process_name")
+            processNames[name.processId] = trace.string(name.valueId);
+    }
+
+    std::string out;
+    for (std::map<uint32_t, const char *>::const_iterator it =
+             processNames.begin();
+         it != processNames.end(); ++it) {
+        std::string process;
+        appendVarintField(process, ProcessPidField, perfettoPid(it->first));
+        appendBytesField(process, ProcessNameField, it->second);
+
+        std::string descriptor;
+        appendVarintField(descriptor, TrackUuidField,
+                          processTrackUuid(it->first));
+        appendBytesField(descriptor, TrackProcessField, process);
+        appendTrackDescriptor(out, descriptor);
+    }
+
+    for (std::map<uint64_t, std::vector<SliceMarker>>::iterator it =
+             tracks.begin();
+         it != tracks.end(); ++it) {
+        const uint32_t processId = static_cast<uint32_t>(it->first >> 32);
+        const uint32_t threadId = static_cast<uint32_t>(it->first);
+        const uint64_t uuid = threadTrackUuid(it->first);
+
+        std::string thread;
+        appendVarintField(thread, ThreadPidField, perfettoPid(processId));
+        appendVarintField(thread, ThreadTidField, threadId);
+        std::map<uint64_t, const char *>::const_iterator name =
+            threadNames.find(it->first);
+        if (name != threadNames.end())
+            appendBytesField(thread, ThreadNameField, name->second);
+
+        std::string descriptor;
+        appendVarintField(descriptor, TrackUuidField, uuid);
+        appendBytesField(descriptor, TrackThreadField, thread);
+        appendTrackDescriptor(out, descriptor);
+
+        std::vector<SliceMarker> &markers = it->second;
+        std::sort(markers.begin(), markers.end(), markerOrder);
+
+        for (std::size_t i = 0; i < markers.size(); i++) {
+            const SliceMarker &marker = markers[i];
+
+            std::string event;
+            appendVarintField(event, EventTypeField,
+                              marker.kind == MarkerBegin     ? SliceBegin
+                              : marker.kind == MarkerInstant ? Instant
+                                                             : SliceEnd);
+            appendVarintField(event, EventTrackUuidField, uuid);
+            if (marker.kind != MarkerEnd) {
+                appendBytesField(event, EventCategoriesField,
+                                 trace.string(marker.event->categoryId));
+                appendBytesField(event, EventNameField,
+                                 trace.string(marker.event->nameId));
+            }
+            if (marker.kind == MarkerBegin && marker.event->allocations != 0) {
+                std::string annotation;
+                appendBytesField(annotation, AnnotationNameField,
+                                 "allocations");
+                appendVarintField(annotation, AnnotationUintField,
+                                  marker.event->allocations);
+                appendBytesField(event, EventAnnotationField, annotation);
+            }
+            if (marker.kind == MarkerInstant && marker.event->stackId != 0) {
+                std::string annotation;
+                appendBytesField(annotation, AnnotationNameField, "stack");
+                appendBytesField(annotation, AnnotationStringField,
+                                 trace.stacks[marker.event->stackId - 1]);
+                appendBytesField(event, EventAnnotationField, annotation);
+            }
+            appendTrackEvent(out, marker.timestamp, event);
+        }
+    }
+
+    std::size_t counterIndex = 0;
+    for (std::map<std::pair<uint32_t, std::string>,
+                  std::vector<const Event *>>::const_iterator it =
+             counters.begin();
+         it != counters.end(); ++it, ++counterIndex) {
+        const uint64_t uuid = counterTrackUuid(counterIndex);
+
+        std::string descriptor;
+        appendVarintField(descriptor, TrackUuidField, uuid);
+        appendBytesField(descriptor, TrackNameField, it->first.second);
+        if (processNames.count(it->first.first) != 0)
+            appendVarintField(descriptor, TrackParentField,
+                              processTrackUuid(it->first.first));
+        appendBytesField(descriptor, TrackCounterField, std::string());
+        appendTrackDescriptor(out, descriptor);
+
+        const std::vector<const Event *> &samples = it->second;
+        for (std::size_t i = 0; i < samples.size(); i++) {
+            double value;
+            std::memcpy(&value, &samples[i]->payload, sizeof(value));
+
+            std::string event;
+            appendVarintField(event, EventTypeField, Counter);
+            appendVarintField(event, EventTrackUuidField, uuid);
+            appendDoubleField(event, EventDoubleValueField, value);
+            appendTrackEvent(
+                out,
+                toNanoseconds(trace, trace.originTicks + samples[i]->start),
+                event);
+        }
+    }
+
+    std::ofstream file(filePath, std::ios::binary | std::ios::trunc);
+    if (!file.is_open())
+        return false;
+
+    file.write(out.data(), static_cast<std::streamsize>(out.size()));
+    return true;
+};
+
+void printUsage() {
+    std::fprintf(stderr, "Usage: gtfo_convert <input.gtfo> <output> "
+                         "[--format chrome|perfetto]\n");
+};
+} // namespace
+
+int main(int argc, char *argv[]) {
+    if (argc < 3) {
+        printUsage();
+        return EXIT_FAILURE;
+    }
+
+    std::string format = "chrome";
+    for (int i = 3; i < argc; i++) {
+        if (std::strcmp(argv[i], "--format") == 0 && i + 1 < argc) {
+            format = argv[++i];
+        } else {
+            printUsage();
+            return EXIT_FAILURE;
+        }
+    }
+
+    Trace trace;
+    if (!readTrace(argv[1], trace))
+        return EXIT_FAILURE;
+
+    if (!trace.isComplete)
+        std::fprintf(stderr, "Warning: %s is truncated, converting the %zu "
+                             "events that were read\n",
+                     argv[1], trace.events.size());
+
+    if (!trace.samples.empty())
+        symbolizeSamples(trace);
+
+    bool isWritten = false;
+    if (format == "chrome") {
+        isWritten = writeChrome(trace, argv[2]);
+    } else if (format == "perfetto") {
+        isWritten = writePerfetto(trace, argv[2]);
+    } else {
+        printUsage();
+        return EXIT_FAILURE;
+    }
+
+    if (!isWritten) {
+        std::fprintf(stderr, "Failed to write %s\n", argv[2]);
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,489 @@
+/**
+ * gtfo_diff
+ * Compares Chrome trace JSON sessions from two builds. Complete events are
+ * aligned by call path (or by name alone) and every scope reports its change
+ * in total time, self time and count. With several sessions per side the
+ * change is tested with Welch's t-test on the per-session totals.
+ *
+ * Usage: gtfo_diff [options] <baseline.json> <candidate.json>
+ *        gtfo_diff [options] <baseline.json>... -- <candidate.json>...
+ *
+ * Binary .gtfo traces have to go through gtfo_convert first.
+ */
+#include <nlohmann/json.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace {
+// NOTE: Chrome timestamps are microseconds with a nanosecond fraction, a
+// child ending on its parent's last nanosecond still nests
+const double NestingSlackMicroseconds = 0.001;
+const char PathSeparator[] = " > ";
+
+enum class KeyMode { Path, Name };
+
+struct Options {
+    KeyMode keyMode{KeyMode::Path};
+    bool isJSON{false};
+    std::size_t top{40};
+    double alpha{0.05};
+    std::vector<const char *> baseline;
+    std::vector<const char *> candidate;
+};
+
+struct ScopeTotals {
+    double total{0.0}; // microseconds
+    double self{0.0};
+    double count{0.0};
+};
+
+typedef std::map<std::string, ScopeTotals> Session;
+
+struct Slice {
+    std::string name;
+    double start;
+    double duration;
+};
+
+struct OpenSlice {
+    double end;
+    std::string key;
+    std::string path;
+};
+
+// A session cut short by a crash lacks the closing bracket, everything up
+// to the last complete event is still usable
+bool parseTrace(const std::string &text, nlohmann::json &trace) {
+    trace = nlohmann::json::parse(text, nullptr, false);
+    if (!trace.is_discarded())
+        return true;
+
+    const std::size_t last = text.rfind('}');
+    if (last == std::string::npos)
+        return false;
+    trace = nlohmann::json::parse(text.substr(0, last + 1) + "]", nullptr,
+                                  false);
+    return !trace.is_discarded();
+};
+
+bool loadSession(const char *filePath, KeyMode keyMode, Session &session) {
+    std::ifstream file(filePath, std::ios::binary);
+    if (!file.is_open()) {
+        std::fprintf(stderr, "Failed to open %s\n", filePath);
+        return false;
+    }
+    const std::string text((std::istreambuf_iterator<char>(file)),
+                           std::istreambuf_iterator<char>());
+
+    nlohmann::json trace;
+    if (!parseTrace(text, trace)) {
+        std::fprintf(stderr, "%s is not a Chrome trace JSON file\n",
+                     filePath);
+        return false;
+    }
+    const nlohmann::json &events =
+        trace.is_object() ? trace["traceEvents"] : trace;
+    if (!events.is_array()) {
+        std::fprintf(stderr, "%s has no trace events\n", filePath);
+        return false;
+    }
+
+    std::map<std::pair<uint64_t, uint64_t>, std::vector<Slice>> tracks;
+    for (nlohmann::json::const_iterator it = events.begin();
+         it != events.end(); ++it) {
+        const nlohmann::json &event = *it;
+        if (!event.is_object() || event.value("ph", "") != "X")
+            continue;
+
+        Slice slice;
+        slice.name = event.value("name", "");
+        slice.start = event.value("ts", 0.0);
+        slice.duration = event.value("dur", 0.0);
+        tracks[std::make_pair(event.value("pid", uint64_t(0)),
+                              event.value("tid", uint64_t(0)))]
+            .push_back(slice);
+    }
+
+    // NOTE: Parents first, a parent and child starting together are told
+    // apart by the longer duration
+    for (std::map<std::pair<uint64_t, uint64_t>,
+                  std::vector<Slice>>::iterator it = tracks.begin();
+         it != tracks.end(); ++it) {
+        std::vector<Slice> &slices = it->second;
+        std::stable_sort(slices.begin(), slices.end(),
+                         [](const Slice &a, const Slice &b) {
+                             return a.start != b.start
+                                        ? a.start < b.start
+                                        : a.duration > b.duration;
+                         });
+
+        std::vector<OpenSlice> stack;
+        for (std::size_t i = 0; i < slices.size(); i++) {
+            const Slice &slice = slices[i];
+            const double end = slice.start + slice.duration;
+            while (!stack.empty() &&
+                   end > stack.back().end + NestingSlackMicroseconds)
+                stack.pop_back();
+
+            OpenSlice open;
+            open.end = end;
+            open.path = stack.empty()
+                            ? slice.name
+                            : stack.back().path + PathSeparator + slice.name;
+            open.key = (keyMode == KeyMode::Path) ? open.path : slice.name;
+
+            if (!stack.empty())
+                session[stack.back().key].self -= slice.duration;
+
+            // NOTE: By name, a recursive scope is already counted in full by
+            // its outermost instance
+            bool isRecursive = false;
+            for (std::size_t j = 0; j < stack.size() && !isRecursive; j++)
+                isRecursive = stack[j].key == open.key;
+
+            ScopeTotals &totals = session[open.key];
+            if (!isRecursive)
+                totals.total += slice.duration;
+            totals.self += slice.duration;
+            totals.count += 1.0;
+            stack.push_back(open);
+        }
+    }
+    return true;
+};
+
+// Regularized incomplete beta function by Lentz's continued fraction
+double betaContinuedFraction(double a, double b, double x) {
+    const int MaxIterations = 300;
+    const double Epsilon = 1e-14;
+    const double Tiny = 1e-300;
+
+    double c = 1.0;
+    double d = 1.0 - (a + b) * x / (a + 1.0);
+    if (std::fabs(d) < Tiny)
+        d = Tiny;
+    d = 1.0 / d;
+    double fraction = d;
+
+    for (int m = 1; m <= MaxIterations; m++) {
+        for (int step = 0; step < 2; step++) {
+            const double numerator =
+                (step == 0) ? m * (b - m) * x / ((a + 2 * m - 1) * (a + 2 * m))
+                            : -(a + m) * (a + b + m) * x /
+                                  ((a + 2 * m) * (a + 2 * m + 1));
+            d = 1.0 + numerator * d;
+            if (std::fabs(d) < Tiny)
+                d = Tiny;
+            c = 1.0 + numerator / c;
+            if (std::fabs(c) < Tiny)
+                c = Tiny;
+            d = 1.0 / d;
+            fraction *= d * c;
+        }
+        if (std::fabs(d * c - 1.0) < Epsilon)
+            break;
+    }
+    return fraction;
+};
+
+double incompleteBeta(double a, double b, double x) {
+    if (x <= 0.0)
+        return 0.0;
+    if (x >= 1.0)
+        return 1.0;
+
+    const double front =
+        std::exp(std::lgamma(a + b) - std::lgamma(a) - std::lgamma(b) +
+                 a * std::log(x) + b * std::log(1.0 - x));
+    if (x < (a + 1.0) / (a + b + 2.0))
+        return front * betaContinuedFraction(a, b, x) / a;
+    return 1.0 - front * betaContinuedFraction(b, a, 1.0 - x) / b;
+};
+
+struct Sample {
+    double mean{0.0};
+    double variance{0.0};
+    std::size_t count{0};
+};
+
+Sample describe(const std::vector<double> &values) {
+    Sample sample;
+    sample.count = values.size();
+    if (values.empty())
+        return sample;
+
+    for (std::size_t i = 0; i < values.size(); i++)
+        sample.mean += values[i];
+    sample.mean /= static_cast<double>(values.size());
+
+    if (values.size() > 1) {
+        for (std::size_t i = 0; i < values.size(); i++)
+            sample.variance +=
+                (values[i] - sample.mean) * (values[i] - sample.mean);
+        sample.variance /= static_cast<double>(values.size() - 1);
+    }
+    return sample;
+};
+
+// Two-sided p-value of Welch's t-test, NAN without two sessions per side
+double welchPValue(const Sample &a, const Sample &b) {
+    if (a.count < 2 || b.count < 2)
+        return NAN;
+
+    const double errorA = a.variance / static_cast<double>(a.count);
+    const double errorB = b.variance / static_cast<double>(b.count);
+    const double error = errorA + errorB;
+    if (error == 0.0)
+        return (a.mean == b.mean) ? 1.0 : 0.0;
+
+    const double t = (b.mean - a.mean) / std::sqrt(error);
+    const double degrees =
+        error * error / (errorA * errorA / static_cast<double>(a.count - 1) +
+                         errorB * errorB / static_cast<double>(b.count - 1));
+    return incompleteBeta(degrees / 2.0, 0.5, degrees / (degrees + t * t));
+};
+
+struct ScopeDiff {
+    std::string key;
+    Sample baseTotal;
+    Sample newTotal;
+    double baseSelf;
+    double newSelf;
+    double baseCount;
+    double newCount;
+    double pValue;
+
+    double delta() const { return newTotal.mean - baseTotal.mean; };
+};
+
+// Per-session values of one scope, 0 in sessions where it never ran
+void collect(const std::vector<Session> &sessions, const std::string &key,
+             std::vector<double> &totals, double &self, double &count) {
+    totals.clear();
+    self = 0.0;
+    count = 0.0;
+    for (std::size_t i = 0; i < sessions.size(); i++) {
+        Session::const_iterator it = sessions[i].find(key);
+        const bool isFound = (it != sessions[i].end());
+        totals.push_back(isFound ? it->second.total : 0.0);
+        self += isFound ? it->second.self : 0.0;
+        count += isFound ? it->second.count : 0.0;
+    }
+    self /= static_cast<double>(sessions.size());
+    count /= static_cast<double>(sessions.size());
+};
+
+std::vector<ScopeDiff> diffSessions(const std::vector<Session> &baseline,
+                                    const std::vector<Session> &candidate) {
+    std::map<std::string, bool> keys;
+    for (std::size_t i = 0; i < baseline.size(); i++)
+        for (Session::const_iterator it = baseline[i].begin();
+             it != baseline[i].end(); ++it)
+            keys[it->first] = true;
+    for (std::size_t i = 0; i < candidate.size(); i++)
+        for (Session::const_iterator it = candidate[i].begin();
+             it != candidate[i].end(); ++it)
+            keys[it->first] = true;
+
+    std::vector<ScopeDiff> diffs;
+    std::vector<double> totals;
+    for (std::map<std::string, bool>::const_iterator it = keys.begin();
+         it != keys.end(); ++it) {
+        ScopeDiff diff;
+        diff.key = it->first;
+        collect(baseline, diff.key, totals, diff.baseSelf, diff.baseCount);
+        diff.baseTotal = describe(totals);
+        collect(candidate, diff.key, totals, diff.newSelf, diff.newCount);
+        diff.newTotal = describe(totals);
+        diff.pValue = welchPValue(diff.baseTotal, diff.newTotal);
+        diffs.push_back(diff);
+    }
+
+    std::sort(diffs.begin(), diffs.end(),
+              [](const ScopeDiff &a, const ScopeDiff &b) {
+                  return std::fabs(a.delta()) > std::fabs(b.delta());
+              });
+    return diffs;
+};
+
+// Long call paths keep their innermost end, that is the part that differs
+std::string label(const std::string &key, std::size_t width) {
+    if (key.size() <= width)
+        return key;
+    return "..." + key.substr(key.size() - (width - 3));
+};
+
+double percentChange(double before, double after) {
+    return (before != 0.0) ? (after - before) / before * 100.0 : NAN;
+};
+
+void writeTable(const Options &options, const std::vector<ScopeDiff> &diffs) {
+    std::printf("GTFO diff: %zu baseline vs %zu candidate sessions, by %s\n\n",
+                options.baseline.size(), options.candidate.size(),
+                options.keyMode == KeyMode::Path ? "call path" : "name");
+    std::printf("%-48s %10s %10s %10s %8s %10s %9s %9s %8s\n", "Scope",
+                "Base ms", "New ms", "Delta ms", "Delta %", "Self d ms",
+                "Base n", "New n", "p");
+
+    const std::size_t count = std::min(options.top, diffs.size());
+    for (std::size_t i = 0; i < count; i++) {
+        const ScopeDiff &diff = diffs[i];
+        char pValue[16] = "-";
+        if (!std::isnan(diff.pValue))
+            std::snprintf(pValue, sizeof(pValue), "%.3f%s", diff.pValue,
+                          diff.pValue < options.alpha ? "*" : " ");
+
+        // Scopes that only the candidate has cannot change by a percentage
+        char percent[16] = "new";
+        const double change =
+            percentChange(diff.baseTotal.mean, diff.newTotal.mean);
+        if (!std::isnan(change))
+            std::snprintf(percent, sizeof(percent), "%+.1f", change);
+
+        std::printf("%-48s %10.3f %10.3f %+10.3f %8s %+10.3f %9.1f %9.1f "
+                    "%8s\n",
+                    label(diff.key, 48).c_str(), diff.baseTotal.mean / 1e3,
+                    diff.newTotal.mean / 1e3, diff.delta() / 1e3, percent,
+                    (diff.newSelf - diff.baseSelf) / 1e3, diff.baseCount,
+                    diff.newCount, pValue);
+    }
+
+    if (diffs.size() > count)
+        std::printf("\n%zu more scopes, raise --top to list them\n",
+                    diffs.size() - count);
+    if (options.baseline.size() > 1 && options.candidate.size() > 1)
+        std::printf("\n* significant at alpha %.3g (Welch's t-test on "
+                    "per-session totals)\n",
+                    options.alpha);
+};
+
+// NOTE: NAN has no JSON spelling, missing statistics are written as null
+nlohmann::json number(double value) {
+    return std::isnan(value) ? nlohmann::json() : nlohmann::json(value);
+};
+
+void writeJSON(const Options &options, const std::vector<ScopeDiff> &diffs) {
+    nlohmann::json scopes = nlohmann::json::array();
+    const std::size_t count = std::min(options.top, diffs.size());
+    for (std::size_t i = 0; i < count; i++) {
+        const ScopeDiff &diff = diffs[i];
+        nlohmann::json scope;
+        scope["scope"] = diff.key;
+        scope["baseTotalUs"] = diff.baseTotal.mean;
+        scope["newTotalUs"] = diff.newTotal.mean;
+        scope["deltaTotalUs"] = diff.delta();
+        scope["deltaPercent"] =
+            number(percentChange(diff.baseTotal.mean, diff.newTotal.mean));
+        scope["baseSelfUs"] = diff.baseSelf;
+        scope["newSelfUs"] = diff.newSelf;
+        scope["baseCount"] = diff.baseCount;
+        scope["newCount"] = diff.newCount;
+        scope["pValue"] = number(diff.pValue);
+        scope["isSignificant"] =
+            !std::isnan(diff.pValue) && diff.pValue < options.alpha;
+        scopes.push_back(scope);
+    }
+
+    nlohmann::json report;
+    report["keyMode"] = options.keyMode == KeyMode::Path ? "path" : "name";
+    report["baselineSessions"] = options.baseline.size();
+    report["candidateSessions"] = options.candidate.size();
+    report["alpha"] = options.alpha;
+    report["scopes"] = scopes;
+    std::cout << report.dump(2) << '\n';
+};
+
+void printUsage() {
+    std::fprintf(stderr,
+                 "Usage: gtfo_diff [options] <baseline.json> "
+                 "<candidate.json>\n"
+                 "       gtfo_diff [options] <baseline.json>... -- "
+                 "<candidate.json>...\n"
+                 "Options:\n"
+                 "  --by path|name        align scopes by call path "
+                 "(default) or name\n"
+                 "  --format table|json   report format (default table)\n"
+                 "  --top N               scopes to list, largest change "
+                 "first (default 40)\n"
+                 "  --alpha A             significance level (default "
+                 "0.05)\n");
+};
+
+bool parseArguments(int argc, char *argv[], Options &options) {
+    std::vector<const char *> files;
+    bool hasSeparator = false;
+    for (int i = 1; i < argc; i++) {
+        const bool hasValue = i + 1 < argc;
+        if (std::strcmp(argv[i], "--by") == 0 && hasValue) {
+            const std::string mode = argv[++i];
+            if (mode != "path" && mode != "name")
+                return false;
+            options.keyMode = (mode == "path") ? KeyMode::Path : KeyMode::Name;
+        } else if (std::strcmp(argv[i], "--format") == 0 && hasValue) {
+            const std::string format = argv[++i];
+            if (format != "table" && format != "json")
+                return false;
+            options.isJSON = (format == "json");
+        } else if (std::strcmp(argv[i], "--top") == 0 && hasValue) {
+            options.top = static_cast<std::size_t>(std::atol(argv[++i]));
+        } else if (std::strcmp(argv[i], "--alpha") == 0 && hasValue) {
+            options.alpha = std::atof(argv[++i]);
+        } else if (std::strcmp(argv[i], "--") == 0 && !hasSeparator) {
+            hasSeparator = true;
+            options.baseline = files;
+            files.clear();
+        } else if (argv[i][0] == '-' && argv[i][1] == '-') {
+            return false;
+        } else {
+            files.push_back(argv[i]);
+        }
+    }
+
+    if (hasSeparator) {
+        options.candidate = files;
+    } else if (files.size() == 2) {
+        options.baseline.push_back(files[0]);
+        options.candidate.push_back(files[1]);
+    }
+    return !options.baseline.empty() && !options.candidate.empty();
+};
+
+bool loadSessions(const std::vector<const char *> &filePaths, KeyMode keyMode,
+                  std::vector<Session> &sessions) {
+    sessions.resize(filePaths.size());
+    for (std::size_t i = 0; i < filePaths.size(); i++)
+        if (!loadSession(filePaths[i], keyMode, sessions[i]))
+            return false;
+    return true;
+};
+} // namespace
+
+int main(int argc, char *argv[]) {
+    Options options;
+    if (!parseArguments(argc, argv, options)) {
+        printUsage();
+        return EXIT_FAILURE;
+    }
+
+    std::vector<Session> baseline, candidate;
+    if (!loadSessions(options.baseline, options.keyMode, baseline) ||
+        !loadSessions(options.candidate, options.keyMode, candidate))
+        return EXIT_FAILURE;
+
+    const std::vector<ScopeDiff> diffs = diffSessions(baseline, candidate);
+    if (options.isJSON)
+        writeJSON(options, diffs);
+    else
+        writeTable(options, diffs);
+    return EXIT_SUCCESS;
+}
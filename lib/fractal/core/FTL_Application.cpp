@@ -1,27 +1,238 @@
 #include "FTL_Application.h"
 #include <utility/FTL_Log.h>
 
+namespace {
+constexpr double ZoomStepFactor      = 1.25;
+constexpr double IterationStepFactor = 2.0;
+
+FTL::Application *getApplication(GLFWwindow *pWindow) {
+    return static_cast<FTL::Application *>(glfwGetWindowUserPointer(pWindow));
+};
+
+// NOTE: Cursor positions are in screen coordinates, the view is in pixels
+void toFramebufferCoords(GLFWwindow *pWindow, double &x, double &y) {
+    int windowWidth, windowHeight, fbWidth, fbHeight;
+    glfwGetWindowSize(pWindow, &windowWidth, &windowHeight);
+    glfwGetFramebufferSize(pWindow, &fbWidth, &fbHeight);
+
+    if (windowWidth > 0 && windowHeight > 0) {
+        x *= static_cast<double>(fbWidth) / windowWidth;
+        y *= static_cast<double>(fbHeight) / windowHeight;
+    };
+};
+}; // namespace
+
 namespace FTL {
 Application::Application() {
     mWindowData = WindowData {.name = "Fractal", .width = 1920, .height = 1080};
     mRenderer   = std::make_unique<Renderer>();
 };
 
-Application::~Application() { mRenderer->shutdown(&mWindowData.window); };
+Application::~Application() {
+    mRenderer->shutdown(&mWindowData.window);
+    Log::shutdown();
+};
 
 void Application::init() {
     Log::init();
 
     FTL_DEBUG("Calling Renderer::createInstance()...");
     mRenderer->init(&mWindowData);
+    registerWindowCallbacks();
 };
 
 void Application::run() {
+    mRenderThread = std::thread(&Application::renderLoop, this);
+
     while (!glfwWindowShouldClose(mWindowData.window)) {
-        glfwPollEvents();
-        mRenderer->render();
+        glfwWaitEvents();
     }
 
+    postCommand({.type = ViewCommandType::Quit});
+    mRenderThread.join();
+
     mRenderer->waitIdle();
 };
+
+bool Application::runBenchmark(const BenchmarkOptions &options) {
+    Log::init();
+
+    const BenchmarkScript script = BenchmarkScript::load(options.scriptPath);
+    mWindowData.isHeadless       = true;
+    mWindowData.width            = script.width;
+    mWindowData.height           = script.height;
+    mRenderer->init(&mWindowData);
+
+    Benchmark benchmark(*mRenderer, script);
+    benchmark.run();
+    mRenderer->waitIdle();
+    benchmark.writeReport(options.reportPath);
+
+    if (options.isRecording) {
+        if (!options.goldenDir.empty())
+            benchmark.recordGoldens(options.goldenDir);
+        if (!options.baselinePath.empty())
+            benchmark.recordTiming(options.baselinePath);
+        return true;
+    };
+
+    uint32_t failures = 0;
+    if (!options.goldenDir.empty())
+        failures += benchmark.checkGoldens(options.goldenDir);
+    if (!options.baselinePath.empty())
+        failures += benchmark.checkTiming(options.baselinePath,
+                                          options.maxSlowdownPercent);
+
+    if (failures != 0)
+        FTL_ERROR("Benchmark {}: {} regression check(s) failed",
+                  options.scriptPath, failures);
+    return failures == 0;
+};
+
+void Application::postCommand(const ViewCommand &command) {
+    // NOTE: Never drop input, if the render thread is behind wait for a slot
+    while (!mCommandQueue.tryPush(command)) {
+        std::this_thread::yield();
+    }
+
+    mCommandSignal.fetch_add(1, std::memory_order_release);
+    mCommandSignal.notify_one();
+};
+
+void Application::renderLoop() {
+    GTFO_PROFILE_SAMPLE_THREAD();
+    bool isIconified = false;
+
+    while (true) {
+        const uint32_t signal = mCommandSignal.load(std::memory_order_acquire);
+        GTFO_PROFILE_COUNTER("Command Queue Depth", mCommandQueue.sizeApprox());
+
+        ViewCommand command;
+        while (mCommandQueue.tryPop(command)) {
+            switch (command.type) {
+            case ViewCommandType::Quit:
+                return;
+
+            case ViewCommandType::Iconify:
+                isIconified = (command.value != 0.0);
+                mRenderer->invalidate();
+                break;
+
+            default:
+                mRenderer->applyCommand(command);
+                break;
+            };
+        }
+
+        if (isIconified || !mRenderer->hasPendingWork()) {
+            // NOTE: Sleep until the event thread posts another command
+            mCommandSignal.wait(signal, std::memory_order_acquire);
+            continue;
+        }
+
+        mRenderer->render();
+    }
+};
+
+void Application::registerWindowCallbacks() {
+    GLFWwindow *pWindow = mWindowData.window;
+    glfwSetWindowUserPointer(pWindow, this);
+
+    glfwSetWindowRefreshCallback(pWindow, onWindowRefresh);
+    glfwSetWindowIconifyCallback(pWindow, onWindowIconify);
+    glfwSetFramebufferSizeCallback(pWindow, onFramebufferResize);
+    glfwSetKeyCallback(pWindow, onKey);
+    glfwSetMouseButtonCallback(pWindow, onMouseButton);
+    glfwSetCursorPosCallback(pWindow, onCursorPos);
+    glfwSetScrollCallback(pWindow, onScroll);
+};
+
+void Application::onWindowRefresh(GLFWwindow *pWindow) {
+    getApplication(pWindow)->postCommand({.type = ViewCommandType::Redraw});
+};
+
+void Application::onWindowIconify(GLFWwindow *pWindow, int iconified) {
+    getApplication(pWindow)->postCommand(
+        {.type  = ViewCommandType::Iconify,
+         .value = (iconified == GLFW_TRUE) ? 1.0 : 0.0});
+};
+
+void Application::onFramebufferResize(GLFWwindow *pWindow, int width,
+                                      int height) {
+    getApplication(pWindow)->postCommand({.type = ViewCommandType::Redraw});
+};
+
+void Application::onKey(GLFWwindow *pWindow, int key, int scancode, int action,
+                        int mods) {
+    if (action == GLFW_RELEASE)
+        return;
+
+    Application *pApp = getApplication(pWindow);
+    switch (key) {
+    case GLFW_KEY_ESCAPE:
+        glfwSetWindowShouldClose(pWindow, GLFW_TRUE);
+        break;
+
+    case GLFW_KEY_R:
+        pApp->postCommand({.type = ViewCommandType::Reset});
+        break;
+
+    case GLFW_KEY_K:
+        pApp->postCommand({.type = ViewCommandType::ToggleKernel});
+        break;
+
+    case GLFW_KEY_UP:
+        pApp->postCommand({.type  = ViewCommandType::ScaleIterations,
+                           .value = IterationStepFactor});
+        break;
+
+    case GLFW_KEY_DOWN:
+        pApp->postCommand({.type  = ViewCommandType::ScaleIterations,
+                           .value = 1.0 / IterationStepFactor});
+        break;
+
+    default:
+        break;
+    };
+};
+
+void Application::onMouseButton(GLFWwindow *pWindow, int button, int action,
+                                int mods) {
+    if (button != GLFW_MOUSE_BUTTON_LEFT)
+        return;
+
+    Application *pApp = getApplication(pWindow);
+    pApp->mIsDragging = (action == GLFW_PRESS);
+    if (pApp->mIsDragging) {
+        glfwGetCursorPos(pWindow, &pApp->mCursorX, &pApp->mCursorY);
+        toFramebufferCoords(pWindow, pApp->mCursorX, pApp->mCursorY);
+    };
+};
+
+void Application::onCursorPos(GLFWwindow *pWindow, double x, double y) {
+    Application *pApp = getApplication(pWindow);
+    if (!pApp->mIsDragging)
+        return;
+
+    toFramebufferCoords(pWindow, x, y);
+    pApp->postCommand({.type = ViewCommandType::Pan,
+                       .x    = x - pApp->mCursorX,
+                       .y    = y - pApp->mCursorY});
+
+    pApp->mCursorX = x;
+    pApp->mCursorY = y;
+};
+
+void Application::onScroll(GLFWwindow *pWindow, double xOffset,
+                           double yOffset) {
+    double x, y;
+    glfwGetCursorPos(pWindow, &x, &y);
+    toFramebufferCoords(pWindow, x, y);
+
+    getApplication(pWindow)->postCommand(
+        {.type  = ViewCommandType::Zoom,
+         .x     = x,
+         .y     = y,
+         .value = std::pow(ZoomStepFactor, yOffset)});
+};
 }; // namespace FTL
@@ -1,23 +1,59 @@
 #pragma once
 
+#include "FTL_Benchmark.h"
 #include "FTL_Window.h"
 #include <memory>
 #include <renderer/FTL_Renderer.h>
+#include <utility/FTL_SPSCQueue.h>
+#include <utility/FTL_Types.h>
 #include <utility/FTL_pch.h>
 
 namespace FTL {
 
 class Application {
   private:
+    static constexpr std::size_t CommandQueueCapacity = 1024;
+
     WindowData mWindowData;
     std::unique_ptr<Renderer> mRenderer;
 
+    // NOTE: The main thread owns GLFW and only produces commands, the render
+    // thread owns every Vulkan object after init() and only consumes them.
+    SPSCQueue<ViewCommand, CommandQueueCapacity> mCommandQueue;
+    std::atomic<uint32_t> mCommandSignal {0};
+    std::thread mRenderThread;
+
+    // Main thread input state
+    bool mIsDragging {false};
+    double mCursorX {0.0};
+    double mCursorY {0.0};
+
+    void registerWindowCallbacks();
+    void postCommand(const ViewCommand &command);
+    void renderLoop();
+
+    static void onWindowRefresh(GLFWwindow *pWindow);
+    static void onWindowIconify(GLFWwindow *pWindow, int iconified);
+    static void onFramebufferResize(GLFWwindow *pWindow, int width,
+                                    int height);
+    static void onKey(GLFWwindow *pWindow, int key, int scancode, int action,
+                      int mods);
+    static void onMouseButton(GLFWwindow *pWindow, int button, int action,
+                              int mods);
+    static void onCursorPos(GLFWwindow *pWindow, double x, double y);
+    static void onScroll(GLFWwindow *pWindow, double xOffset, double yOffset);
+
   public:
     Application();
     ~Application();
 
     void init();
     void run();
+
+    // NOTE: Headless replacement for init() and run(), renders the script
+    // at its resolution, writes the JSON report and runs or records the
+    // regression checks the options ask for. False when a check failed.
+    bool runBenchmark(const BenchmarkOptions &options);
 };
 
 }; // namespace FTL
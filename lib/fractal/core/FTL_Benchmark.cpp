@@ -0,0 +1,701 @@
+#include "FTL_Benchmark.h"
+#include <utility/FTL_Log.h>
+
+#include <cctype>
+#include <numeric>
+#include <sstream>
+
+namespace {
+struct Distribution {
+    double mean {0.0};
+    double min {0.0};
+    double p50 {0.0};
+    double p90 {0.0};
+    double p95 {0.0};
+    double p99 {0.0};
+    double max {0.0};
+};
+
+// NOTE: Nearest-rank percentiles, every value reported is a real sample
+Distribution summarize(std::vector<double> values) {
+    Distribution distribution;
+    if (values.empty())
+        return distribution;
+
+    std::sort(values.begin(), values.end());
+    const auto percentile = [&values](double p) {
+        const std::size_t rank = static_cast<std::size_t>(
+            std::ceil(p / 100.0 * static_cast<double>(values.size())));
+        return values[std::clamp<std::size_t>(rank, 1, values.size()) - 1];
+    };
+
+    distribution.mean = std::accumulate(values.begin(), values.end(), 0.0) /
+                        static_cast<double>(values.size());
+    distribution.min  = values.front();
+    distribution.p50  = percentile(50.0);
+    distribution.p90  = percentile(90.0);
+    distribution.p95  = percentile(95.0);
+    distribution.p99  = percentile(99.0);
+    distribution.max  = values.back();
+    return distribution;
+};
+
+std::string escapeJson(std::string_view text) {
+    std::string escaped;
+    escaped.reserve(text.size());
+    for (const char c : text) {
+        if (c == '"' || c == '\\') {
+            escaped += '\\';
+            escaped += c;
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+            escaped += fmt::format("\\u{:04x}", c);
+        } else {
+            escaped += c;
+        }
+    }
+    return escaped;
+};
+
+void appendDistribution(std::string &json, const char *name,
+                        const Distribution &distribution) {
+    fmt::format_to(std::back_inserter(json),
+                   "    \"{}\": {{\"mean\": {}, \"min\": {}, \"p50\": {}, "
+                   "\"p90\": {}, \"p95\": {}, \"p99\": {}, \"max\": {}}},\n",
+                   name, distribution.mean, distribution.min, distribution.p50,
+                   distribution.p90, distribution.p95, distribution.p99,
+                   distribution.max);
+};
+
+const char *kernelName(FTL::KernelMode kernel) {
+    return kernel == FTL::KernelMode::Persistent ? "persistent" : "naive";
+};
+
+// Hold, Pan and Zoom, the steps the timing baseline is kept for
+const char *timedCommand(FTL::BenchmarkStepType type) {
+    switch (type) {
+    case FTL::BenchmarkStepType::Hold:
+        return "hold";
+    case FTL::BenchmarkStepType::Pan:
+        return "pan";
+    case FTL::BenchmarkStepType::Zoom:
+        return "zoom";
+    default:
+        return nullptr;
+    };
+};
+
+bool isStepName(std::string_view name) {
+    return !name.empty() && std::all_of(name.begin(), name.end(), [](char c) {
+        return std::isalnum(static_cast<unsigned char>(c)) || c == '_' ||
+               c == '-';
+    });
+};
+
+// NOTE: GPU timestamps when every frame has one, the fence wait otherwise
+bool hasGpuTimes(const std::vector<FTL::BenchmarkFrame> &frames) {
+    return std::all_of(frames.begin(), frames.end(),
+                       [](const FTL::BenchmarkFrame &frame) {
+                           return frame.stats.gpuMs > 0.0;
+                       });
+};
+
+constexpr std::array<char, 8> GoldenMagic {'F', 'T', 'L', 'G',
+                                           'O', 'L', 'D', '1'};
+
+// Golden files are this header followed by width * height uint32_t counts,
+// all in the writing machine's byte order
+struct GoldenHeader {
+    std::array<char, 8> magic;
+    uint32_t width;
+    uint32_t height;
+    uint32_t maxIterations;
+    uint32_t reserved;
+};
+
+void writeGolden(const std::filesystem::path &path,
+                 const FTL::BenchmarkCapture &capture) {
+    const GoldenHeader header {GoldenMagic, capture.width, capture.height,
+                               capture.view.maxIterations, 0};
+
+    if (path.has_parent_path())
+        std::filesystem::create_directories(path.parent_path());
+
+    std::ofstream file(path, std::ios::binary);
+    file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char *>(capture.counts.data()),
+               static_cast<std::streamsize>(capture.counts.size() *
+                                            sizeof(uint32_t)));
+    if (!file) {
+        const std::string errMsg = "Failed to write golden " + path.string();
+        FTL_ERROR("{}", errMsg);
+        throw std::runtime_error(errMsg);
+    };
+};
+
+// False when the file is not a complete golden iteration buffer
+bool readGolden(const std::filesystem::path &path, GoldenHeader &header,
+                std::vector<uint32_t> &counts) {
+    std::ifstream file(path, std::ios::binary);
+    file.read(reinterpret_cast<char *>(&header), sizeof(header));
+    if (!file || header.magic != GoldenMagic)
+        return false;
+
+    counts.resize(static_cast<std::size_t>(header.width) * header.height);
+    file.read(reinterpret_cast<char *>(counts.data()),
+              static_cast<std::streamsize>(counts.size() * sizeof(uint32_t)));
+    return static_cast<bool>(file);
+};
+
+struct StepTiming {
+    std::string name;
+    uint32_t line;
+    std::vector<double> frameMs {};
+};
+
+// NOTE: A step's frames are rendered back to back, so they are adjacent
+std::vector<StepTiming>
+stepTimings(const std::vector<FTL::BenchmarkFrame> &frames, bool isGpuClock) {
+    std::vector<StepTiming> steps;
+    for (const FTL::BenchmarkFrame &frame : frames) {
+        if (steps.empty() || steps.back().name != frame.step)
+            steps.push_back({.name = frame.step, .line = frame.line});
+        steps.back().frameMs.push_back(isGpuClock ? frame.stats.gpuMs
+                                                  : frame.stats.submitMs);
+    }
+    return steps;
+};
+}; // namespace
+
+namespace FTL {
+BenchmarkScript BenchmarkScript::load(const std::string &path) {
+    std::ifstream file(path);
+    if (!file.is_open()) {
+        const std::string errMsg = "Failed to open benchmark script " + path;
+        FTL_ERROR("{}", errMsg);
+        throw std::runtime_error(errMsg);
+    };
+
+    BenchmarkScript script {.path = path};
+    uint32_t lineNumber = 0;
+    const auto fail     = [&](std::string_view reason) {
+        const std::string errMsg =
+            fmt::format("{}:{}: {}", path, lineNumber, reason);
+        FTL_ERROR("{}", errMsg);
+        throw std::runtime_error(errMsg);
+    };
+
+    bool hasFrames         = false;
+    bool hasMeasuredFrames = false;
+    std::string line;
+    while (std::getline(file, line)) {
+        lineNumber++;
+        line = line.substr(0, line.find('#'));
+
+        std::istringstream stream(line);
+        std::string command;
+        if (!(stream >> command))
+            continue;
+
+        BenchmarkStep step {.line = lineNumber};
+        if (command == "resolution") {
+            if (hasFrames)
+                fail("resolution must come before the first frame");
+            stream >> script.width >> script.height;
+            if (stream.fail() || script.width == 0 || script.height == 0)
+                fail("expected resolution <width> <height>");
+        } else if (command == "kernel") {
+            std::string kernel;
+            stream >> kernel;
+            if (kernel != "naive" && kernel != "persistent")
+                fail("expected kernel naive|persistent");
+            step.type   = BenchmarkStepType::Kernel;
+            step.kernel = (kernel == "persistent") ? KernelMode::Persistent
+                                                   : KernelMode::Naive;
+        } else if (command == "view") {
+            step.type = BenchmarkStepType::View;
+            stream >> step.x >> step.y >> step.value;
+            if (stream.fail() || step.value <= 0.0)
+                fail("expected view <centerX> <centerY> <height>");
+        } else if (command == "iterations") {
+            step.type = BenchmarkStepType::Iterations;
+            stream >> step.value;
+            if (stream.fail() || step.value < 1.0)
+                fail("expected iterations <limit>");
+        } else if (command == "warmup" || command == "hold") {
+            step.type = (command == "warmup") ? BenchmarkStepType::Warmup
+                                              : BenchmarkStepType::Hold;
+            stream >> step.frames;
+            if (stream.fail() || step.frames == 0)
+                fail("expected " + command + " <frames>");
+            if (command == "hold")
+                stream >> step.name;
+        } else if (command == "pan") {
+            step.type = BenchmarkStepType::Pan;
+            stream >> step.x >> step.y >> step.frames;
+            if (stream.fail() || step.frames == 0)
+                fail("expected pan <dx> <dy> <frames> [name]");
+            stream >> step.name;
+        } else if (command == "zoom") {
+            step.type = BenchmarkStepType::Zoom;
+            stream >> step.value >> step.frames;
+            if (stream.fail() || step.value <= 0.0 || step.frames == 0)
+                fail("expected zoom <factor> <frames> [name]");
+            stream >> step.name;
+        } else if (command == "tolerance") {
+            step.type = BenchmarkStepType::Tolerance;
+            stream >> step.value >> step.x;
+            if (stream.fail() || step.value < 0.0 || step.x < 0.0 ||
+                step.x > 1.0)
+                fail("expected tolerance <iterations> <fraction>");
+        } else if (command == "capture") {
+            step.type = BenchmarkStepType::Capture;
+            stream >> step.name;
+            if (!isStepName(step.name))
+                fail("expected capture <name>, name is [A-Za-z0-9_-]+");
+            for (const BenchmarkStep &other : script.steps) {
+                if (other.type == BenchmarkStepType::Capture &&
+                    other.name == step.name)
+                    fail("capture " + step.name + " already exists");
+            }
+        } else {
+            fail("unknown command " + command);
+        };
+
+        if (timedCommand(step.type) != nullptr && !step.name.empty() &&
+            !isStepName(step.name))
+            fail("step name " + step.name + " is not [A-Za-z0-9_-]+");
+
+        std::string extra;
+        if (stream >> extra)
+            fail("unexpected " + extra + " after " + command);
+
+        if (command == "resolution")
+            continue;
+
+        hasFrames |=
+            (step.frames != 0 || step.type == BenchmarkStepType::Capture);
+        hasMeasuredFrames |=
+            (step.frames != 0 && step.type != BenchmarkStepType::Warmup);
+        script.steps.push_back(step);
+    }
+
+    if (!hasMeasuredFrames)
+        fail("the script renders no measured frames");
+
+    // NOTE: Named only now, so an explicit name that matches a generated
+    // one is caught below as well
+    uint32_t timedSteps = 0;
+    for (BenchmarkStep &step : script.steps) {
+        const char *command = timedCommand(step.type);
+        if (command == nullptr)
+            continue;
+
+        timedSteps++;
+        if (step.name.empty())
+            step.name = fmt::format("{}_{}", command, timedSteps);
+    }
+
+    for (std::size_t i = 0; i < script.steps.size(); i++) {
+        const BenchmarkStep &step = script.steps[i];
+        if (timedCommand(step.type) == nullptr)
+            continue;
+
+        for (std::size_t j = 0; j < i; j++) {
+            if (timedCommand(script.steps[j].type) != nullptr &&
+                script.steps[j].name == step.name) {
+                lineNumber = step.line;
+                fail("step " + step.name + " already exists");
+            };
+        }
+    }
+
+    return script;
+};
+
+Benchmark::Benchmark(Renderer &renderer, const BenchmarkScript &script)
+    : mRenderer(renderer), mScript(script) {};
+
+void Benchmark::run() {
+    GTFO_PROFILE_FUNCTION();
+    mFrames.clear();
+    mCaptures.clear();
+    mKernel           = KernelMode::Naive;
+    mPixelTolerance   = 0;
+    mMismatchFraction = 0.0;
+    mRenderer.setBenchmarkMode(true);
+    mRenderer.setKernelMode(mKernel);
+    mRenderer.setView(View {});
+
+    const auto startTime = std::chrono::steady_clock::now();
+    for (const BenchmarkStep &step : mScript.steps) {
+        View view = mRenderer.view();
+        switch (step.type) {
+        case BenchmarkStepType::View:
+            view.centerX = step.x;
+            view.centerY = step.y;
+            view.height  = step.value;
+            mRenderer.setView(view);
+            break;
+
+        case BenchmarkStepType::Iterations:
+            view.maxIterations = static_cast<uint32_t>(step.value);
+            mRenderer.setView(view);
+            break;
+
+        case BenchmarkStepType::Kernel:
+            mKernel = step.kernel;
+            mRenderer.setKernelMode(mKernel);
+            break;
+
+        case BenchmarkStepType::Warmup:
+        case BenchmarkStepType::Hold:
+            for (uint32_t i = 0; i < step.frames; i++)
+                renderFrame(step, step.type == BenchmarkStepType::Hold);
+            break;
+
+        case BenchmarkStepType::Pan:
+            for (uint32_t i = 0; i < step.frames; i++) {
+                view          = mRenderer.view();
+                view.centerX += step.x * view.height / step.frames;
+                view.centerY += step.y * view.height / step.frames;
+                mRenderer.setView(view);
+                renderFrame(step, true);
+            }
+            break;
+
+        case BenchmarkStepType::Zoom: {
+            const double factor = std::pow(step.value, 1.0 / step.frames);
+            for (uint32_t i = 0; i < step.frames; i++) {
+                view         = mRenderer.view();
+                view.height /= factor;
+                mRenderer.setView(view);
+                renderFrame(step, true);
+            }
+            break;
+        }
+
+        case BenchmarkStepType::Tolerance:
+            mPixelTolerance   = static_cast<uint32_t>(step.value);
+            mMismatchFraction = step.x;
+            break;
+
+        case BenchmarkStepType::Capture:
+            captureFrame(step);
+            break;
+        };
+    }
+
+    const std::chrono::duration<double> wallTime =
+        std::chrono::steady_clock::now() - startTime;
+    mWallSeconds = wallTime.count();
+    FTL_INFO("Benchmark {}: {} frames in {:.2f} s", mScript.path,
+             mFrames.size(), mWallSeconds);
+};
+
+void Benchmark::renderFrame(const BenchmarkStep &step, bool isMeasured) {
+    const FrameStats stats = mRenderer.render();
+    if (!isMeasured)
+        return;
+
+    const std::vector<uint32_t> counts = mRenderer.readIterations();
+    const std::size_t pixelCount =
+        static_cast<std::size_t>(stats.extent.width) * stats.extent.height;
+    const uint64_t iterations = std::accumulate(
+        counts.begin(), counts.begin() + pixelCount, uint64_t {0});
+
+    mFrames.push_back({.line       = step.line,
+                       .step       = step.name,
+                       .view       = mRenderer.view(),
+                       .kernel     = mKernel,
+                       .stats      = stats,
+                       .iterations = iterations});
+};
+
+void Benchmark::captureFrame(const BenchmarkStep &step) {
+    const FrameStats stats       = mRenderer.render();
+    std::vector<uint32_t> counts = mRenderer.readIterations();
+    counts.resize(static_cast<std::size_t>(stats.extent.width) *
+                  stats.extent.height);
+
+    mCaptures.push_back({.name             = step.name,
+                         .line             = step.line,
+                         .view             = mRenderer.view(),
+                         .kernel           = mKernel,
+                         .width            = stats.extent.width,
+                         .height           = stats.extent.height,
+                         .pixelTolerance   = mPixelTolerance,
+                         .mismatchFraction = mMismatchFraction,
+                         .counts           = std::move(counts)});
+};
+
+void Benchmark::writeReport(const std::string &path) const {
+    std::vector<double> cpuMs, submitMs, gpuMs;
+    uint64_t totalPixels = 0, totalIterations = 0;
+    double totalSubmitMs = 0.0, totalGpuMs = 0.0;
+    bool hasGpuTimes = true;
+    for (const BenchmarkFrame &frame : mFrames) {
+        const uint64_t pixels =
+            static_cast<uint64_t>(frame.stats.extent.width) *
+            frame.stats.extent.height;
+
+        cpuMs.push_back(frame.stats.cpuMs);
+        submitMs.push_back(frame.stats.submitMs);
+        gpuMs.push_back(frame.stats.gpuMs);
+        totalSubmitMs   += frame.stats.submitMs;
+        totalGpuMs      += frame.stats.gpuMs;
+        totalPixels     += pixels;
+        totalIterations += frame.iterations;
+        hasGpuTimes     &= (frame.stats.gpuMs > 0.0);
+    }
+
+    // NOTE: Throughput is per second of GPU time, the fence wait stands in
+    // when the queue has no timestamps
+    const double throughputSeconds =
+        (hasGpuTimes ? totalGpuMs : totalSubmitMs) / 1e3;
+
+    std::string json;
+    auto out = std::back_inserter(json);
+    fmt::format_to(out, "{{\n");
+    fmt::format_to(out, "  \"script\": \"{}\",\n", escapeJson(mScript.path));
+    fmt::format_to(out, "  \"device\": \"{}\",\n",
+                   escapeJson(mRenderer.deviceName()));
+    fmt::format_to(out, "  \"driver\": \"{}\",\n",
+                   escapeJson(mRenderer.driverInfo()));
+    fmt::format_to(out, "  \"extent\": [{}, {}],\n", mScript.width,
+                   mScript.height);
+    fmt::format_to(out, "  \"frameCount\": {},\n", mFrames.size());
+    fmt::format_to(out, "  \"wallSeconds\": {},\n", mWallSeconds);
+
+    fmt::format_to(out, "  \"summary\": {{\n");
+    appendDistribution(json, "cpuMs", summarize(cpuMs));
+    appendDistribution(json, "submitMs", summarize(submitMs));
+    if (hasGpuTimes)
+        appendDistribution(json, "gpuMs", summarize(gpuMs));
+    fmt::format_to(out, "    \"throughputClock\": \"{}\",\n",
+                   hasGpuTimes ? "gpu" : "submit");
+    fmt::format_to(out, "    \"totalPixels\": {},\n", totalPixels);
+    fmt::format_to(out, "    \"totalIterations\": {},\n", totalIterations);
+    fmt::format_to(out, "    \"pixelsPerSecond\": {},\n",
+                   static_cast<double>(totalPixels) / throughputSeconds);
+    fmt::format_to(out, "    \"iterationsPerSecond\": {}\n",
+                   static_cast<double>(totalIterations) / throughputSeconds);
+    fmt::format_to(out, "  }},\n");
+
+    fmt::format_to(out, "  \"frames\": [\n");
+    for (std::size_t i = 0; i < mFrames.size(); i++) {
+        const BenchmarkFrame &frame = mFrames[i];
+        fmt::format_to(
+            out,
+            "    {{\"index\": {}, \"line\": {}, \"step\": \"{}\", "
+            "\"kernel\": \"{}\", "
+            "\"centerX\": {}, \"centerY\": {}, \"height\": {}, "
+            "\"maxIterations\": {}, \"extent\": [{}, {}], \"cpuMs\": {}, "
+            "\"submitMs\": {}, \"gpuMs\": {}, \"iterations\": {}}}{}\n",
+            i, frame.line, escapeJson(frame.step), kernelName(frame.kernel),
+            frame.view.centerX,
+            frame.view.centerY, frame.view.height, frame.view.maxIterations,
+            frame.stats.extent.width, frame.stats.extent.height,
+            frame.stats.cpuMs, frame.stats.submitMs, frame.stats.gpuMs,
+            frame.iterations, (i + 1 < mFrames.size()) ? "," : "");
+    }
+    fmt::format_to(out, "  ]\n}}\n");
+
+    const std::filesystem::path reportPath(path);
+    if (reportPath.has_parent_path())
+        std::filesystem::create_directories(reportPath.parent_path());
+
+    std::ofstream file(reportPath);
+    file << json;
+    if (!file) {
+        const std::string errMsg = "Failed to write benchmark report " + path;
+        FTL_ERROR("{}", errMsg);
+        throw std::runtime_error(errMsg);
+    };
+
+    FTL_INFO("Benchmark report written to {}: {:.3g} pixels/s, {:.3g} "
+             "iterations/s",
+             path, static_cast<double>(totalPixels) / throughputSeconds,
+             static_cast<double>(totalIterations) / throughputSeconds);
+};
+
+void Benchmark::recordGoldens(const std::string &dir) const {
+    for (const BenchmarkCapture &capture : mCaptures) {
+        const std::filesystem::path goldenPath =
+            std::filesystem::path(dir) / (capture.name + ".ftlgold");
+        writeGolden(goldenPath, capture);
+        std::filesystem::remove(std::filesystem::path(dir) /
+                                (capture.name + ".actual.ftlgold"));
+        FTL_INFO("Golden {} recorded to {}", capture.name,
+                 goldenPath.string());
+    }
+};
+
+uint32_t Benchmark::checkGoldens(const std::string &dir) const {
+    uint32_t failures = 0;
+    for (const BenchmarkCapture &capture : mCaptures) {
+        const std::filesystem::path goldenPath =
+            std::filesystem::path(dir) / (capture.name + ".ftlgold");
+        const std::filesystem::path actualPath =
+            std::filesystem::path(dir) / (capture.name + ".actual.ftlgold");
+
+        if (!std::filesystem::exists(goldenPath)) {
+            FTL_ERROR("{}:{}: no golden {} for capture {}, record one with "
+                      "--record",
+                      mScript.path, capture.line, goldenPath.string(),
+                      capture.name);
+            failures++;
+            continue;
+        };
+
+        GoldenHeader header;
+        std::vector<uint32_t> golden;
+        if (!readGolden(goldenPath, header, golden)) {
+            FTL_ERROR("{} is not a golden iteration buffer",
+                      goldenPath.string());
+            failures++;
+            continue;
+        };
+
+        if (header.width != capture.width || header.height != capture.height ||
+            header.maxIterations != capture.view.maxIterations) {
+            writeGolden(actualPath, capture);
+            FTL_ERROR("{}:{}: golden {} is {}x{} at {} iterations, the "
+                      "capture is {}x{} at {}",
+                      mScript.path, capture.line, capture.name, header.width,
+                      header.height, header.maxIterations, capture.width,
+                      capture.height, capture.view.maxIterations);
+            failures++;
+            continue;
+        };
+
+        std::size_t mismatches = 0;
+        uint32_t maxDifference = 0;
+        for (std::size_t i = 0; i < golden.size(); i++) {
+            const uint32_t difference = (golden[i] > capture.counts[i])
+                                            ? golden[i] - capture.counts[i]
+                                            : capture.counts[i] - golden[i];
+            maxDifference  = std::max(maxDifference, difference);
+            mismatches    += (difference > capture.pixelTolerance);
+        }
+
+        const double mismatchFraction = static_cast<double>(mismatches) /
+                                        static_cast<double>(golden.size());
+        if (mismatchFraction > capture.mismatchFraction) {
+            writeGolden(actualPath, capture);
+            FTL_ERROR("{}:{}: capture {} has {} of {} pixels off by more than "
+                      "{} iterations (max {}), wrote {}",
+                      mScript.path, capture.line, capture.name, mismatches,
+                      golden.size(), capture.pixelTolerance, maxDifference,
+                      actualPath.string());
+            failures++;
+        } else {
+            // Left over from an earlier failing run
+            std::filesystem::remove(actualPath);
+            FTL_INFO("Capture {} matches its golden, {} pixels off by more "
+                     "than {} iterations (max {})",
+                     capture.name, mismatches, capture.pixelTolerance,
+                     maxDifference);
+        };
+    }
+    return failures;
+};
+
+void Benchmark::recordTiming(const std::string &baselinePath) const {
+    const bool isGpuClock = hasGpuTimes(mFrames);
+
+    const std::filesystem::path path(baselinePath);
+    if (path.has_parent_path())
+        std::filesystem::create_directories(path.parent_path());
+
+    std::ofstream baseline(path);
+    baseline << "# FTL timing baseline for " << mScript.path
+             << ", rerun with --record to replace it\n";
+    baseline << "device " << mRenderer.deviceName() << "\n";
+    baseline << "clock " << (isGpuClock ? "gpu" : "submit") << "\n";
+    for (const StepTiming &step : stepTimings(mFrames, isGpuClock))
+        baseline << fmt::format("step {} {}\n", step.name,
+                                summarize(step.frameMs).p50);
+    if (!baseline) {
+        const std::string errMsg =
+            "Failed to write timing baseline " + baselinePath;
+        FTL_ERROR("{}", errMsg);
+        throw std::runtime_error(errMsg);
+    };
+
+    FTL_INFO("Timing baseline recorded to {}", baselinePath);
+};
+
+uint32_t Benchmark::checkTiming(const std::string &baselinePath,
+                                double maxSlowdownPercent) const {
+    const bool isGpuClock = hasGpuTimes(mFrames);
+    const char *clock     = isGpuClock ? "gpu" : "submit";
+    const std::vector<StepTiming> steps = stepTimings(mFrames, isGpuClock);
+
+    std::ifstream file(baselinePath);
+    if (!file.is_open()) {
+        FTL_ERROR("No timing baseline {}, record one with --record",
+                  baselinePath);
+        return 1;
+    };
+
+    std::string device, baselineClock;
+    std::vector<std::pair<std::string, double>> baselineSteps;
+    std::string line;
+    while (std::getline(file, line)) {
+        std::istringstream stream(line);
+        std::string key;
+        if (!(stream >> key) || key.starts_with('#'))
+            continue;
+
+        if (key == "device") {
+            std::getline(stream >> std::ws, device);
+        } else if (key == "clock") {
+            stream >> baselineClock;
+        } else if (key == "step") {
+            std::pair<std::string, double> step;
+            if (stream >> step.first >> step.second)
+                baselineSteps.push_back(step);
+        };
+    }
+
+    if (device != mRenderer.deviceName() || baselineClock != clock) {
+        FTL_ERROR("Timing baseline {} is from {} with the {} clock, this run "
+                  "is on {} with the {} clock",
+                  baselinePath, device, baselineClock, mRenderer.deviceName(),
+                  clock);
+        return 1;
+    };
+
+    uint32_t failures = 0;
+    for (const StepTiming &step : steps) {
+        const auto baseline =
+            std::find_if(baselineSteps.begin(), baselineSteps.end(),
+                         [&step](const std::pair<std::string, double> &entry) {
+                             return entry.first == step.name;
+                         });
+        if (baseline == baselineSteps.end() || baseline->second <= 0.0) {
+            FTL_ERROR("{}:{}: no timing for step {} in baseline {}, record "
+                      "it again with --record",
+                      mScript.path, step.line, step.name, baselinePath);
+            failures++;
+            continue;
+        };
+
+        const double medianMs = summarize(step.frameMs).p50;
+        const double slowdown = (medianMs / baseline->second - 1.0) * 100.0;
+        if (slowdown > maxSlowdownPercent) {
+            FTL_ERROR("{}:{}: step {} median frame {:.3f} ms, {:+.1f}% "
+                      "against the baseline's {:.3f} ms, limit {:.1f}%",
+                      mScript.path, step.line, step.name, medianMs, slowdown,
+                      baseline->second, maxSlowdownPercent);
+            failures++;
+        } else {
+            FTL_INFO("{}:{}: step {} median frame {:.3f} ms, {:+.1f}% "
+                     "against the baseline's {:.3f} ms",
+                     mScript.path, step.line, step.name, medianMs, slowdown,
+                     baseline->second);
+        };
+    }
+    return failures;
+};
+}; // namespace FTL
@@ -0,0 +1,144 @@
+#pragma once
+
+#include <renderer/FTL_Renderer.h>
+#include <utility/FTL_Types.h>
+#include <utility/FTL_pch.h>
+
+namespace FTL {
+enum class BenchmarkStepType : uint8_t {
+    View,       // x, y: center, value: view height
+    Iterations, // value: iteration limit
+    Kernel,     // kernel: escape kernel for the following frames
+    Warmup,     // frames rendered at the current view, not measured
+    Hold,       // frames rendered at the current view
+    Pan,        // x, y: total center offset in view heights
+    Zoom,       // value: total zoom factor around the center
+    Tolerance,  // value: per-pixel iterations, x: fraction of pixels past it
+    Capture,    // name: golden iteration buffer of the current view
+};
+
+struct BenchmarkStep {
+    BenchmarkStepType type {BenchmarkStepType::Hold};
+    uint32_t line {0}; // In the script, reported with every frame
+    double x {0.0};
+    double y {0.0};
+    double value {0.0};
+    uint32_t frames {0};
+    KernelMode kernel {KernelMode::Naive};
+    std::string name {}; // Capture: golden, Hold, Pan, Zoom: timing step
+};
+
+// NOTE: A plain text camera path, one command per line, '#' starts a
+// comment:
+//
+//   resolution <width> <height>  headless swap chain size, 1920 x 1080
+//   kernel naive|persistent
+//   view <centerX> <centerY> <height>
+//   iterations <limit>
+//   warmup <frames>
+//   hold <frames> [name]
+//   pan <dx> <dy> <frames> [name]
+//                                dx, dy in view heights, spread evenly
+//   zoom <factor> <frames> [name]
+//                                zooms in by factor, geometrically
+//   tolerance <iterations> <fraction>
+//                                for the following captures, a golden check
+//                                fails when more than fraction of the pixels
+//                                differ by more than iterations, default 0 0
+//   capture <name>               renders the current view once, unmeasured,
+//                                and keeps its iteration counts for a golden
+//                                check, name is [A-Za-z0-9_-]+ and unique
+//
+// The timing baseline is keyed by the name of each hold, pan and zoom. One
+// left unnamed is called after its command and its position among them,
+// hold_3 for a hold that comes third. Names follow the capture rules.
+//
+// Every run starts from the default View with the naive kernel, so a
+// script always replays the same sequence of frames.
+struct BenchmarkScript {
+    std::string path;
+    uint32_t width {1920};
+    uint32_t height {1080};
+    std::vector<BenchmarkStep> steps {};
+
+    // Throws std::runtime_error naming the offending line
+    static BenchmarkScript load(const std::string &path);
+};
+
+struct BenchmarkFrame {
+    uint32_t line;
+    std::string step; // Name of the step that rendered it
+    View view;
+    KernelMode kernel;
+    FrameStats stats;
+    uint64_t iterations; // Sum of the frame's per-pixel iteration counts
+};
+
+struct BenchmarkCapture {
+    std::string name;
+    uint32_t line;
+    View view;
+    KernelMode kernel;
+    uint32_t width;
+    uint32_t height;
+    uint32_t pixelTolerance;
+    double mismatchFraction;
+    std::vector<uint32_t> counts; // width * height, row major
+};
+
+struct BenchmarkOptions {
+    std::string scriptPath;
+    std::string reportPath {"logs/FTLBenchmark.json"};
+    std::string goldenDir {};    // Empty skips the golden checks
+    std::string baselinePath {}; // Empty skips the timing check
+    double maxSlowdownPercent {10.0};
+    bool isRecording {false}; // Write goldens and baseline instead of checks
+};
+
+// NOTE: Replays a BenchmarkScript on a renderer in benchmark mode. Frames
+// are rendered back to back on the calling thread, after each measured
+// frame its iteration counts are read back outside the timed region.
+class Benchmark {
+  private:
+    Renderer &mRenderer;
+    const BenchmarkScript &mScript;
+    std::vector<BenchmarkFrame> mFrames {};
+    std::vector<BenchmarkCapture> mCaptures {};
+    KernelMode mKernel {KernelMode::Naive};
+    uint32_t mPixelTolerance {0};
+    double mMismatchFraction {0.0};
+    double mWallSeconds {0.0};
+
+    void renderFrame(const BenchmarkStep &step, bool isMeasured);
+    void captureFrame(const BenchmarkStep &step);
+
+  public:
+    Benchmark(Renderer &renderer, const BenchmarkScript &script);
+
+    void run();
+
+    // JSON with the device, per-frame timings and their summary
+    void writeReport(const std::string &path) const;
+
+    // NOTE: Regression checks against files written by the record calls
+    // on an earlier run. A missing file fails its check, recording is always
+    // explicit. The checks return the number of failures.
+
+    // Each capture to <dir>/<name>.ftlgold
+    void recordGoldens(const std::string &dir) const;
+
+    // Each capture against <dir>/<name>.ftlgold, a mismatch is written next
+    // to it as <name>.actual.ftlgold
+    uint32_t checkGoldens(const std::string &dir) const;
+
+    // Median frame time of every frame-rendering step, with the device and
+    // clock it was measured on
+    void recordTiming(const std::string &baselinePath) const;
+
+    // Fails a step that got slower than its baseline median by more than
+    // maxSlowdownPercent. Baselines only compare runs on the same device
+    // and clock.
+    uint32_t checkTiming(const std::string &baselinePath,
+                         double maxSlowdownPercent) const;
+};
+}; // namespace FTL
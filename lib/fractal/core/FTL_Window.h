@@ -4,9 +4,13 @@
 
 namespace FTL {
 struct WindowData {
-    GLFWwindow *window;
+    GLFWwindow *window {nullptr};
     const char *name {"DefaultWindowName"};
     uint32_t width {800};
     uint32_t height {600};
+
+    // NOTE: No GLFW window at all, the swap chain is created on a
+    // VK_EXT_headless_surface of width x height, e.g. for benchmarks
+    bool isHeadless {false};
 };
 }; // namespace FTL
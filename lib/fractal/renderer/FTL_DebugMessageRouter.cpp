@@ -0,0 +1,189 @@
+#include "FTL_DebugMessageRouter.h"
+#include "gtfo_profiler.h"
+#include <utility/FTL_Log.h>
+
+#include <unordered_set>
+
+namespace {
+struct RateLimit {
+    double perSecond;
+    double burst;
+};
+
+// NOTE: Indexed like severityIndex(), verbose through error
+constexpr std::array<RateLimit, 4> RateLimits {
+    RateLimit {10.0, 20.0}, RateLimit {10.0, 20.0}, RateLimit {20.0, 50.0},
+    RateLimit {50.0, 100.0}};
+
+constexpr std::size_t SummaryLength = 20;
+
+// NOTE: Messages without an id name are listed by the start of their text
+constexpr std::size_t UnnamedPrefixLength = 60;
+
+std::size_t severityIndex(vk::DebugUtilsMessageSeverityFlagBitsEXT severity) {
+    switch (severity) {
+    case vk::DebugUtilsMessageSeverityFlagBitsEXT::eVerbose:
+        return 0;
+    case vk::DebugUtilsMessageSeverityFlagBitsEXT::eInfo:
+        return 1;
+    case vk::DebugUtilsMessageSeverityFlagBitsEXT::eWarning:
+        return 2;
+    default:
+        return 3;
+    };
+};
+
+bool isPowerOfTen(uint64_t value) {
+    while (value >= 10 && value % 10 == 0)
+        value /= 10;
+    return value == 1;
+};
+
+// NOTE: GTFO keeps event names by pointer until its session is written out,
+// which happens after the renderer is gone, so they live for the process
+const char *internEventName(const std::string &idName) {
+    static std::unordered_set<std::string> sNames;
+    return sNames.insert("vk: " + idName).first->c_str();
+};
+}; // namespace
+
+namespace FTL {
+DebugMessageRouter::DebugMessageRouter() {
+    const auto now = std::chrono::steady_clock::now();
+    for (std::size_t i = 0; i < SeverityCount; i++) {
+        mBuckets[i].tokens     = RateLimits[i].burst;
+        mBuckets[i].lastRefill = now;
+    }
+};
+
+void DebugMessageRouter::route(
+    vk::DebugUtilsMessageSeverityFlagBitsEXT severity,
+    vk::DebugUtilsMessageTypeFlagsEXT type,
+    const vk::DebugUtilsMessengerCallbackDataEXT &data) {
+    const std::string_view text =
+        data.pMessage != nullptr ? data.pMessage : std::string_view {};
+    const uint64_t key =
+        data.messageIdNumber != 0
+            ? static_cast<uint32_t>(data.messageIdNumber)
+            : std::hash<std::string_view> {}(text) | (uint64_t {1} << 63);
+
+    std::lock_guard<std::mutex> lock(mMutex);
+    auto [it, isNew] = mMessages.try_emplace(key);
+    MessageStats &stats = it->second;
+    stats.count++;
+
+    if (isNew) {
+        stats.idName   = data.pMessageIdName != nullptr
+                             ? data.pMessageIdName
+                             : std::string(text.substr(0, UnnamedPrefixLength));
+        stats.severity = severity;
+        stats.type     = type;
+        if (type & vk::DebugUtilsMessageTypeFlagBitsEXT::ePerformance)
+            stats.eventName = internEventName(stats.idName);
+    }
+
+    if (stats.eventName != nullptr)
+        GTFO_PROFILE_INSTANT(stats.eventName, "vulkan");
+
+    if (!isNew && !isPowerOfTen(stats.count)) {
+        stats.suppressedCount++;
+        return;
+    }
+    if (!takeToken(severityIndex(severity))) {
+        stats.suppressedCount++;
+        return;
+    }
+
+    if (isNew)
+        logMessage(severity, type, text);
+    else
+        logMessage(severity, type,
+                   fmt::format("{} repeated {} times, {} suppressed so far",
+                               stats.idName, stats.count,
+                               stats.suppressedCount));
+};
+
+bool DebugMessageRouter::takeToken(std::size_t severityIndex) {
+    RateBucket &bucket     = mBuckets[severityIndex];
+    const RateLimit &limit = RateLimits[severityIndex];
+
+    const auto now = std::chrono::steady_clock::now();
+    const std::chrono::duration<double> elapsed = now - bucket.lastRefill;
+    bucket.tokens     = std::min(limit.burst, bucket.tokens + elapsed.count() *
+                                                              limit.perSecond);
+    bucket.lastRefill = now;
+
+    if (bucket.tokens < 1.0) {
+        bucket.limitedCount++;
+        return false;
+    }
+    bucket.tokens -= 1.0;
+    return true;
+};
+
+void DebugMessageRouter::logMessage(
+    vk::DebugUtilsMessageSeverityFlagBitsEXT severity,
+    vk::DebugUtilsMessageTypeFlagsEXT type, std::string_view text) {
+    switch (severity) {
+    case vk::DebugUtilsMessageSeverityFlagBitsEXT::eError:
+        FTL_ERROR("[vkValidation:{}] {}", vk::to_string(type), text);
+        break;
+    case vk::DebugUtilsMessageSeverityFlagBitsEXT::eWarning:
+        FTL_WARN("[vkValidation:{}] {}", vk::to_string(type), text);
+        break;
+    default:
+        FTL_DEBUG("[vkValidation:{}] {}", vk::to_string(type), text);
+        break;
+    };
+};
+
+void DebugMessageRouter::logSummary() {
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (mMessages.empty())
+        return;
+
+    std::vector<const MessageStats *> sorted;
+    sorted.reserve(mMessages.size());
+    uint64_t total = 0, suppressed = 0;
+    for (const auto &[key, stats] : mMessages) {
+        sorted.push_back(&stats);
+        total += stats.count;
+        suppressed += stats.suppressedCount;
+    }
+    std::sort(sorted.begin(), sorted.end(),
+              [](const MessageStats *a, const MessageStats *b) {
+                  return a->count > b->count;
+              });
+
+    FTL_INFO("Vulkan debug messages: {} total, {} distinct, {} suppressed",
+             total, sorted.size(), suppressed);
+    for (std::size_t i = 0; i < std::min(sorted.size(), SummaryLength); i++) {
+        const MessageStats &stats = *sorted[i];
+        FTL_INFO("  {:>8} x [{}:{}] {} ({} suppressed)", stats.count,
+                 vk::to_string(stats.severity), vk::to_string(stats.type),
+                 stats.idName, stats.suppressedCount);
+    }
+    if (sorted.size() > SummaryLength)
+        FTL_INFO("  ... and {} more", sorted.size() - SummaryLength);
+
+    for (std::size_t i = 0; i < SeverityCount; i++) {
+        if (mBuckets[i].limitedCount == 0)
+            continue;
+        FTL_INFO("  {} messages held back by the {} rate limit",
+                 mBuckets[i].limitedCount,
+                 vk::to_string(
+                     static_cast<vk::DebugUtilsMessageSeverityFlagBitsEXT>(
+                         1u << (4 * i))));
+    }
+};
+
+VKAPI_ATTR vk::Bool32 VKAPI_CALL DebugMessageRouter::callback(
+    vk::DebugUtilsMessageSeverityFlagBitsEXT severity,
+    vk::DebugUtilsMessageTypeFlagsEXT type,
+    const vk::DebugUtilsMessengerCallbackDataEXT *pCallbackData,
+    void *pUserData) {
+    static_cast<DebugMessageRouter *>(pUserData)->route(severity, type,
+                                                         *pCallbackData);
+    return vk::False;
+};
+}; // namespace FTL
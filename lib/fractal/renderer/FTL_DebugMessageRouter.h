@@ -0,0 +1,61 @@
+#pragma once
+
+#include <utility/FTL_pch.h>
+
+#include <mutex>
+#include <unordered_map>
+
+namespace FTL {
+// NOTE: Receives every VK_EXT_debug_utils message. A message is keyed by
+// its messageIdNumber, a hash of the VUID, or by a hash of its text when
+// the layer leaves the id at 0. The first occurrence of a key is logged in
+// full and repeats only bump its counter, with a short reminder every
+// power of ten. Every severity also has a token bucket, so a burst of
+// distinct messages cannot flood the log either. Performance warnings are
+// additionally written to the GTFO trace as instant events.
+class DebugMessageRouter {
+  private:
+    static constexpr std::size_t SeverityCount = 4;
+
+    struct MessageStats {
+        std::string idName;
+        vk::DebugUtilsMessageSeverityFlagBitsEXT severity;
+        vk::DebugUtilsMessageTypeFlagsEXT type;
+        uint64_t count {0};
+        uint64_t suppressedCount {0};
+        const char *eventName {nullptr}; // Performance messages only
+    };
+
+    struct RateBucket {
+        double tokens {0.0};
+        std::chrono::steady_clock::time_point lastRefill {};
+        uint64_t limitedCount {0};
+    };
+
+    std::mutex mMutex;
+    std::unordered_map<uint64_t, MessageStats> mMessages;
+    std::array<RateBucket, SeverityCount> mBuckets;
+
+    bool takeToken(std::size_t severityIndex);
+    void logMessage(vk::DebugUtilsMessageSeverityFlagBitsEXT severity,
+                    vk::DebugUtilsMessageTypeFlagsEXT type,
+                    std::string_view text);
+
+  public:
+    DebugMessageRouter();
+
+    void route(vk::DebugUtilsMessageSeverityFlagBitsEXT severity,
+               vk::DebugUtilsMessageTypeFlagsEXT type,
+               const vk::DebugUtilsMessengerCallbackDataEXT &data);
+
+    // Logs the most frequent messages and everything that was suppressed
+    void logSummary();
+
+    // pUserData must point at the router
+    static VKAPI_ATTR vk::Bool32 VKAPI_CALL
+    callback(vk::DebugUtilsMessageSeverityFlagBitsEXT severity,
+             vk::DebugUtilsMessageTypeFlagsEXT type,
+             const vk::DebugUtilsMessengerCallbackDataEXT *pCallbackData,
+             void *pUserData);
+};
+}; // namespace FTL
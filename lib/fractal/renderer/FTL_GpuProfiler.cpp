@@ -0,0 +1,264 @@
+#include "FTL_GpuProfiler.h"
+#include <utility/FTL_Log.h>
+
+namespace {
+// NOTE: The two clocks drift apart by a few ppm, re-anchoring this often
+// keeps the GPU track within a microsecond of the CPU scopes.
+constexpr double RecalibrateSeconds = 1.0;
+
+vk::TimeDomainEXT
+pickHostTimeDomain(const std::vector<vk::TimeDomainEXT> &domains) {
+    // NOTE: Ordered by preference, MONOTONIC_RAW is what GTFO reads when the
+    // TSC is unavailable so the anchor is exact in that case
+    constexpr std::array<vk::TimeDomainEXT, 3> Preferred {
+        vk::TimeDomainEXT::eClockMonotonicRaw,
+        vk::TimeDomainEXT::eQueryPerformanceCounter,
+        vk::TimeDomainEXT::eClockMonotonic};
+
+    const bool hasDevice =
+        std::ranges::find(domains, vk::TimeDomainEXT::eDevice) != domains.end();
+
+    for (const vk::TimeDomainEXT domain : Preferred) {
+        if (hasDevice && std::ranges::find(domains, domain) != domains.end())
+            return domain;
+    };
+
+    return vk::TimeDomainEXT::eDevice;
+};
+}; // namespace
+
+namespace FTL {
+void GpuProfiler::init(const vk::raii::PhysicalDevice &physicalDevice,
+                       const vk::raii::Device &device,
+                       uint32_t queueFamilyIndex,
+                       bool hasCalibratedTimestamps) {
+    const uint32_t validBits =
+        physicalDevice.getQueueFamilyProperties()[queueFamilyIndex]
+            .timestampValidBits;
+    if (validBits == 0) {
+        FTL_WARN("Graphics queue does not support timestamps, GPU profiling "
+                 "is disabled");
+        return;
+    };
+
+    mTimestampMask =
+        (validBits >= 64) ? UINT64_MAX : ((uint64_t {1} << validBits) - 1);
+
+    // NOTE: GTFO ticks are only meaningful once its clock is calibrated, the
+    // call is a no-op when a session already did it
+    GTFO::Clock::calibrate();
+    const double nanosecondsPerTick =
+        physicalDevice.getProperties().limits.timestampPeriod;
+    mHostTicksPerDeviceTick =
+        nanosecondsPerTick *
+        static_cast<double>(GTFO::Clock::ticksPerSecond()) / 1e9;
+
+    if (hasCalibratedTimestamps) {
+        mHostDomain = pickHostTimeDomain(
+            physicalDevice.getCalibrateableTimeDomainsEXT());
+        mHasCalibratedTimestamps =
+            (mHostDomain != vk::TimeDomainEXT::eDevice);
+    };
+
+    mQueryPool = vk::raii::QueryPool(
+        device, {.queryType  = vk::QueryType::eTimestamp,
+                 .queryCount = FrameSlots * QueriesPerFrame});
+
+    mTrack       = GTFO::Profiler::get().registerTrack(
+        GpuProcessId, queueFamilyIndex, "GPU", "Graphics Queue");
+    mCategoryBit = GTFO::Profiler::get().categoryBit("gpu");
+    mIsEnabled   = true;
+
+    FTL_DEBUG("GPU profiler: {} valid timestamp bits, {} ns per tick, "
+              "calibrated via {}",
+              validBits, nanosecondsPerTick,
+              mHasCalibratedTimestamps ? vk::to_string(mHostDomain)
+                                       : "fence signals");
+};
+
+void GpuProfiler::beginFrame(const vk::raii::Device &device,
+                             const vk::raii::CommandBuffer &commandBuffer) {
+    if (!mIsEnabled)
+        return;
+
+    resolve(device, mFrameIndex);
+
+    FrameSlot &frame = mFrames[mFrameIndex];
+    frame.scopeNames.clear();
+    frame.isRecorded    = false;
+    frame.completeTicks = 0;
+    mOpenScopes.clear();
+
+    commandBuffer.resetQueryPool(*mQueryPool, mFrameIndex * QueriesPerFrame,
+                                 QueriesPerFrame);
+};
+
+void GpuProfiler::endFrame() {
+    if (!mIsEnabled)
+        return;
+
+    mFrames[mFrameIndex].isRecorded = true;
+    mFrameIndex                     = (mFrameIndex + 1) % FrameSlots;
+};
+
+void GpuProfiler::frameComplete() {
+    if (!mIsEnabled)
+        return;
+
+    const uint32_t lastFrame = (mFrameIndex + FrameSlots - 1) % FrameSlots;
+    mFrames[lastFrame].completeTicks = GTFO::Clock::now();
+};
+
+bool GpuProfiler::resolveCompleted(const vk::raii::Device &device) {
+    if (!mIsEnabled)
+        return false;
+
+    const uint32_t lastFrame = (mFrameIndex + FrameSlots - 1) % FrameSlots;
+    const bool isResolved    = resolve(device, lastFrame);
+
+    mFrames[lastFrame].isRecorded = false;
+    return isResolved;
+};
+
+// NOTE: ALL_COMMANDS on both ends, a begin timestamp at TOP_OF_PIPE would be
+// written before earlier work in the command buffer has finished
+void GpuProfiler::beginScope(const vk::raii::CommandBuffer &commandBuffer,
+                             const char *name) {
+    if (!mIsEnabled)
+        return;
+
+    FrameSlot &frame = mFrames[mFrameIndex];
+    if (frame.scopeNames.size() >= MaxScopesPerFrame) {
+        mOpenScopes.push_back(NoScope);
+        return;
+    };
+
+    const uint32_t scopeIndex = static_cast<uint32_t>(frame.scopeNames.size());
+    frame.scopeNames.push_back(name);
+    mOpenScopes.push_back(scopeIndex);
+
+    commandBuffer.writeTimestamp2(vk::PipelineStageFlagBits2::eAllCommands,
+                                  *mQueryPool,
+                                  mFrameIndex * QueriesPerFrame +
+                                      scopeIndex * 2);
+};
+
+void GpuProfiler::endScope(const vk::raii::CommandBuffer &commandBuffer) {
+    if (!mIsEnabled || mOpenScopes.empty())
+        return;
+
+    const uint32_t scopeIndex = mOpenScopes.back();
+    mOpenScopes.pop_back();
+    if (scopeIndex == NoScope)
+        return;
+
+    commandBuffer.writeTimestamp2(vk::PipelineStageFlagBits2::eAllCommands,
+                                  *mQueryPool,
+                                  mFrameIndex * QueriesPerFrame +
+                                      scopeIndex * 2 + 1);
+};
+
+bool GpuProfiler::resolve(const vk::raii::Device &device,
+                          uint32_t frameIndex) {
+    FrameSlot &frame = mFrames[frameIndex];
+    if (!frame.isRecorded || frame.scopeNames.empty())
+        return false;
+
+    const uint32_t queryCount =
+        static_cast<uint32_t>(frame.scopeNames.size()) * 2;
+    auto [result, timestamps] = mQueryPool.getResults<uint64_t>(
+        frameIndex * QueriesPerFrame, queryCount, queryCount * sizeof(uint64_t),
+        sizeof(uint64_t), vk::QueryResultFlagBits::e64);
+
+    // NOTE: Never wait, a frame that is somehow still in flight loses its
+    // GPU scopes instead of stalling the render thread
+    if (result != vk::Result::eSuccess) {
+        FTL_DEBUG("GPU timestamps for frame slot {} not ready, dropped",
+                  frameIndex);
+        return false;
+    };
+
+    for (uint64_t &timestamp : timestamps)
+        timestamp &= mTimestampMask;
+
+    // NOTE: Scope 0 spans the whole frame, its end is the last GPU work
+    // before the fence signaled
+    const uint64_t frameEnd = timestamps[1];
+    const double ticksPerSecond =
+        static_cast<double>(GTFO::Clock::ticksPerSecond());
+    mLastFrameMs = static_cast<double>((frameEnd - timestamps[0]) &
+                                       mTimestampMask) *
+                   mHostTicksPerDeviceTick * 1e3 / ticksPerSecond;
+
+    const uint64_t now = GTFO::Clock::now();
+    const bool isStale =
+        !mIsCalibrated || static_cast<double>(now - mCalibrationTicks) >
+                              RecalibrateSeconds * ticksPerSecond;
+
+    if (mHasCalibratedTimestamps) {
+        if (isStale)
+            calibrate(device);
+    } else if (frame.completeTicks != 0 &&
+               (isStale || frame.completeTicks < toHostTicks(frameEnd))) {
+        // NOTE: The fence signals after the frame's last timestamp, so the
+        // earliest wake-up seen is the tightest bound on the real offset
+        if (isStale)
+            mCalibrationTicks = now;
+        mDeviceAnchor = frameEnd;
+        mHostAnchor   = frame.completeTicks;
+        mIsCalibrated = true;
+    };
+
+    if (!mIsCalibrated || !GTFO::Profiler::get().isEnabled(mCategoryBit))
+        return true;
+
+    for (std::size_t i = 0; i < frame.scopeNames.size(); i++) {
+        const GTFO::ProfileResult profile {
+            .name     = frame.scopeNames[i],
+            .category = "gpu",
+            .start    = toHostTicks(timestamps[i * 2]),
+            .end      = toHostTicks(timestamps[i * 2 + 1]),
+            .type     = GTFO::EventType::Complete};
+        GTFO::Profiler::get().writeProfile(*mTrack, profile);
+    };
+    return true;
+};
+
+// NOTE: Reads both clocks as close together as the driver can, the GTFO
+// clock is bracketed around the call unless it shares the host domain
+void GpuProfiler::calibrate(const vk::raii::Device &device) {
+    const std::array<vk::CalibratedTimestampInfoEXT, 2> infos {
+        {{.timeDomain = vk::TimeDomainEXT::eDevice},
+         {.timeDomain = mHostDomain}}
+    };
+
+    const uint64_t before = GTFO::Clock::now();
+    const std::vector<uint64_t> timestamps =
+        device.getCalibratedTimestampsEXT(infos).first;
+    const uint64_t after = GTFO::Clock::now();
+
+    const bool isSameDomain =
+        GTFO::Clock::source() == GTFO::Clock::Source::MonotonicRaw &&
+        mHostDomain == vk::TimeDomainEXT::eClockMonotonicRaw;
+
+    mDeviceAnchor     = timestamps[0] & mTimestampMask;
+    mHostAnchor       = isSameDomain ? timestamps[1]
+                                     : before + (after - before) / 2;
+    mCalibrationTicks = after;
+    mIsCalibrated     = true;
+};
+
+uint64_t GpuProfiler::toHostTicks(uint64_t deviceTicks) const {
+    // NOTE: Wraps modulo the valid bits, a timestamp just before the anchor
+    // comes out as a small negative delta rather than a huge positive one
+    const uint64_t delta = (deviceTicks - mDeviceAnchor) & mTimestampMask;
+    int64_t signedDelta  = static_cast<int64_t>(delta);
+    if (mTimestampMask != UINT64_MAX && delta > (mTimestampMask >> 1))
+        signedDelta = static_cast<int64_t>(delta) -
+                      static_cast<int64_t>(mTimestampMask) - 1;
+
+    return mHostAnchor + static_cast<int64_t>(
+                             static_cast<double>(signedDelta) *
+                             mHostTicksPerDeviceTick);
+};
+}; // namespace FTL
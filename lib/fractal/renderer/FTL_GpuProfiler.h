@@ -0,0 +1,103 @@
+#pragma once
+
+#include <utility/FTL_pch.h>
+
+namespace FTL {
+// NOTE: Must match the GTFO pid the GPU track is registered under, CPU
+// threads all live in GTFO::ThreadProcessId
+constexpr uint32_t GpuProcessId = 1;
+
+// NOTE: Brackets command buffer work with timestamp queries and merges the
+// results into the GTFO trace on a GPU track. Each frame owns a slice of the
+// query pool. The renderer waits on mFenceDraw every frame and calls
+// resolveCompleted() right after that wait, so a frame's GPU time is read
+// back synchronously and lastFrameMs() belongs to the frame just rendered.
+// beginFrame() only resolves a slot that was skipped, and resolving never
+// waits on the GPU. Device ticks are mapped onto the GTFO clock with
+// VK_EXT_calibrated_timestamps, or estimated from fence signals when the
+// extension is missing.
+class GpuProfiler {
+  private:
+    static constexpr uint32_t FrameSlots        = 3;
+    static constexpr uint32_t MaxScopesPerFrame = 32;
+    static constexpr uint32_t QueriesPerFrame   = MaxScopesPerFrame * 2;
+    static constexpr uint32_t NoScope           = UINT32_MAX;
+
+    // NOTE: Scope i owns queries 2i and 2i + 1 of the frame's slice
+    struct FrameSlot {
+        std::vector<const char *> scopeNames {};
+        bool isRecorded {false};
+        uint64_t completeTicks {0}; // GTFO clock when the fence signaled
+    };
+
+    vk::raii::QueryPool mQueryPool {nullptr};
+    bool mIsEnabled {false};
+    bool mHasCalibratedTimestamps {false};
+    vk::TimeDomainEXT mHostDomain {vk::TimeDomainEXT::eDevice};
+    uint64_t mTimestampMask {0};
+
+    std::array<FrameSlot, FrameSlots> mFrames {};
+    uint32_t mFrameIndex {0};
+    std::vector<uint32_t> mOpenScopes {};
+
+    // NOTE: hostTicks = mHostAnchor + (deviceTicks - mDeviceAnchor) * ratio
+    bool mIsCalibrated {false};
+    uint64_t mDeviceAnchor {0};
+    uint64_t mHostAnchor {0};
+    double mHostTicksPerDeviceTick {1.0};
+    uint64_t mCalibrationTicks {0};
+
+    GTFO::EventBuffer *mTrack {nullptr};
+    GTFO::CategoryMask mCategoryBit {0};
+    double mLastFrameMs {0.0};
+
+    void calibrate(const vk::raii::Device &device);
+    bool resolve(const vk::raii::Device &device, uint32_t frameIndex);
+    uint64_t toHostTicks(uint64_t deviceTicks) const;
+
+  public:
+    void init(const vk::raii::PhysicalDevice &physicalDevice,
+              const vk::raii::Device &device, uint32_t queueFamilyIndex,
+              bool hasCalibratedTimestamps);
+
+    // NOTE: beginFrame() must be recorded before any scope and endFrame()
+    // after the last one, frameComplete() is called once the frame's fence
+    // has signaled.
+    void beginFrame(const vk::raii::Device &device,
+                    const vk::raii::CommandBuffer &commandBuffer);
+    void endFrame();
+    void frameComplete();
+
+    // Reads back the frame that just completed instead of waiting for its
+    // slot to come around again, only valid once its fence has signaled.
+    // True when lastFrameMs() now holds that frame's GPU time.
+    bool resolveCompleted(const vk::raii::Device &device);
+
+    void beginScope(const vk::raii::CommandBuffer &commandBuffer,
+                    const char *name);
+    void endScope(const vk::raii::CommandBuffer &commandBuffer);
+
+    bool isEnabled() const { return mIsEnabled; };
+
+    // GPU time of the most recently resolved frame, 0 until one resolves
+    double lastFrameMs() const { return mLastFrameMs; };
+};
+
+class GpuScope {
+  private:
+    GpuProfiler &mProfiler;
+    const vk::raii::CommandBuffer &mCommandBuffer;
+
+  public:
+    GpuScope(GpuProfiler &profiler,
+             const vk::raii::CommandBuffer &commandBuffer, const char *name)
+        : mProfiler(profiler), mCommandBuffer(commandBuffer) {
+        mProfiler.beginScope(mCommandBuffer, name);
+    };
+
+    ~GpuScope() { mProfiler.endScope(mCommandBuffer); };
+
+    GpuScope(const GpuScope &)            = delete;
+    GpuScope &operator=(const GpuScope &) = delete;
+};
+}; // namespace FTL
@@ -1,34 +1,25 @@
 #include "FTL_Renderer.h"
+#include "FTL_File.h"
 #include "FTL_Log.h"
 #include "gtfo_profiler.h"
 
 VULKAN_HPP_DEFAULT_DISPATCH_LOADER_DYNAMIC_STORAGE
 
 namespace {
-static std::vector<char> readFile(const std::string &fileName) {
-    std::ifstream file(fileName, std::ios::ate | std::ios::binary);
-
-    if (!file.is_open()) {
-        constexpr const char *errMsg = "Failed to open file!";
-        FTL_ERROR(errMsg);
-        throw std::runtime_error(errMsg);
-    };
-
-    std::vector<char> buffer(file.tellg());
-    file.seekg(0, std::ios::beg);
-    file.read(buffer.data(), static_cast<std::streamsize>(buffer.size()));
-    file.close();
-
-    return buffer;
-};
-
 std::vector<const char *>
-getRequiredExtensions(const bool hasValidationLayerSupport) {
-    uint32_t glfwExtensionCount = 0;
-    const char **glfwExtensions =
-        glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+getRequiredExtensions(const bool hasValidationLayerSupport,
+                      const bool isHeadless) {
+    std::vector<const char *> extensions;
+    if (isHeadless) {
+        extensions = {vk::KHRSurfaceExtensionName,
+                      vk::EXTHeadlessSurfaceExtensionName};
+    } else {
+        uint32_t glfwExtensionCount = 0;
+        const char **glfwExtensions =
+            glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+        extensions.assign(glfwExtensions, glfwExtensions + glfwExtensionCount);
+    };
 
-    std::vector extensions(glfwExtensions, glfwExtensions + glfwExtensionCount);
     if (hasValidationLayerSupport) {
         FTL_DEBUG("Pushing EXTDebugUtilsExtensionName to requiredExtensions");
         extensions.push_back(vk::EXTDebugUtilsExtensionName);
@@ -74,14 +65,17 @@ getSwapChainPresentMode(const std::vector<vk::PresentModeKHR> &availableModes) {
 };
 
 vk::Extent2D getSwapChainExtent(const vk::SurfaceCapabilitiesKHR &capabilities,
-                                GLFWwindow *pWindow) {
+                                const FTL::WindowData *pWinData) {
     if (capabilities.currentExtent.width !=
         std::numeric_limits<uint32_t>::max()) {
         return capabilities.currentExtent;
     };
 
-    int width, height;
-    glfwGetFramebufferSize(pWindow, &width, &height);
+    // NOTE: A headless surface has no extent of its own
+    int width  = static_cast<int>(pWinData->width);
+    int height = static_cast<int>(pWinData->height);
+    if (!pWinData->isHeadless)
+        glfwGetFramebufferSize(pWinData->window, &width, &height);
 
     return {
         .width = std::clamp<uint32_t>(width, capabilities.minImageExtent.width,
@@ -92,26 +86,25 @@ vk::Extent2D getSwapChainExtent(const vk::SurfaceCapabilitiesKHR &capabilities,
     };
 };
 
-static VKAPI_ATTR vk::Bool32 VKAPI_CALL vkDebugCallback(
-    vk::DebugUtilsMessageSeverityFlagBitsEXT severity,
-    vk::DebugUtilsMessageTypeFlagsEXT type,
-    const vk::DebugUtilsMessengerCallbackDataEXT *pCallbackData, void *) {
-
-    FTL_DEBUG("[vkValidation:{}] {}", vk::to_string(type),
-              pCallbackData->pMessage);
+uint32_t findMemoryType(const vk::PhysicalDeviceMemoryProperties &memProperties,
+                        uint32_t typeFilter,
+                        vk::MemoryPropertyFlags properties) {
+    for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) {
+        if ((typeFilter & (1u << i)) &&
+            (memProperties.memoryTypes[i].propertyFlags & properties) ==
+                properties) {
+            return i;
+        };
+    };
 
-    return vk::False;
-}
+    constexpr const char *errMsg = "Failed to find a suitable memory type!";
+    FTL_CRITICAL(errMsg);
+    throw std::runtime_error(errMsg);
+};
 
 }; // namespace
 
 namespace FTL {
-Renderer::Renderer() {};
-
-Renderer::~Renderer() {
-
-};
-
 const std::vector<const char *> ValidationLayers {
     "VK_LAYER_KHRONOS_validation"};
 
@@ -122,16 +115,32 @@ const std::vector<const char *> RequiredDeviceExtensions {
     vk::KHRCreateRenderpass2ExtensionName,
 };
 
+// NOTE: Must match the numthreads() of the kernels in fractal.slang
+constexpr uint32_t NaiveWorkgroupSize       = 8;
+constexpr uint32_t PersistentTileSize       = 16;
+
+// NOTE: Enough resident workgroups to fill a large desktop GPU, anything
+// beyond the tile count simply exits on its first claim.
+constexpr uint32_t PersistentWorkgroupCount = 1024;
+
 #ifndef NDEBUG
 constexpr bool hasValidationLayerSupport = true;
 #else
 constexpr bool hasValidationLayerSupport = false;
 #endif
 
+constexpr double FrameTimeBudgetMs = 1000.0 / 60.0;
+
+Renderer::Renderer() : mResolutionController(FrameTimeBudgetMs) {};
+
+Renderer::~Renderer() {
+
+};
+
 void Renderer::createInstance(WindowData *pWinData) {
     GTFO_PROFILE_FUNCTION();
 
-    {
+    if (!pWinData->isHeadless) {
         GTFO_PROFILE_SCOPE("glfwInit() & glfwCreateWindow()", "scope");
         glfwInit();
         glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
@@ -167,7 +176,7 @@ void Renderer::createInstance(WindowData *pWinData) {
 
     uint32_t glfwExtensionCount = 0;
     const char **glfwExtensions = nullptr;
-    {
+    if (!pWinData->isHeadless) {
         GTFO_PROFILE_SCOPE("Getting GLFW Required Extensions", "scope");
         glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
     }
@@ -175,7 +184,8 @@ void Renderer::createInstance(WindowData *pWinData) {
     std::vector<const char *> requiredExtensions;
     {
         GTFO_PROFILE_SCOPE("Getting Required Extensions", "scope");
-        requiredExtensions = getRequiredExtensions(hasValidationLayerSupport);
+        requiredExtensions = getRequiredExtensions(hasValidationLayerSupport,
+                                                   pWinData->isHeadless);
     }
 
     auto extensionProperties = mContext.enumerateInstanceExtensionProperties();
@@ -242,15 +252,24 @@ void Renderer::setupDebugMessenger() {
     vk::DebugUtilsMessengerCreateInfoEXT createInfo {
         .messageSeverity = severityFlags,
         .messageType     = messageTypeFlags,
-        .pfnUserCallback = &vkDebugCallback};
+        .pfnUserCallback = &DebugMessageRouter::callback,
+        .pUserData       = &mDebugMessageRouter};
 
     mDebugMessenger = mInstance.createDebugUtilsMessengerEXT(createInfo);
 };
 
-void Renderer::createSurface(GLFWwindow *pWindow) {
+void Renderer::createSurface(const WindowData *pWinData) {
     GTFO_PROFILE_FUNCTION();
+    if (pWinData->isHeadless) {
+        mSurface = vk::raii::SurfaceKHR(mInstance,
+                                        vk::HeadlessSurfaceCreateInfoEXT {});
+        FTL_DEBUG("Created a headless Vulkan Surface");
+        return;
+    };
+
     VkSurfaceKHR _surface;
-    if (glfwCreateWindowSurface(*mInstance, pWindow, nullptr, &_surface) !=
+    if (glfwCreateWindowSurface(*mInstance, pWinData->window, nullptr,
+                                &_surface) !=
         VK_SUCCESS) {
         constexpr const char *errMsg = "Failed to create a Vulkan Surface";
         FTL_CRITICAL(errMsg);
@@ -388,6 +407,25 @@ void Renderer::createLogicalDevice() {
         };
     };
 
+    // NOTE: Subgroup votes have no feature bit, support is only reported via
+    // the subgroup properties. Without them the kernels fall back to a
+    // per-lane exit test.
+    auto subgroupChain =
+        mPhysicalDevice.getProperties2<vk::PhysicalDeviceProperties2,
+                                       vk::PhysicalDeviceSubgroupProperties>();
+    const auto &subgroupProperties =
+        subgroupChain.get<vk::PhysicalDeviceSubgroupProperties>();
+
+    mHasSubgroupVote =
+        (subgroupProperties.supportedStages &
+         vk::ShaderStageFlagBits::eCompute) &&
+        (subgroupProperties.supportedOperations &
+         vk::SubgroupFeatureFlagBits::eVote);
+
+    FTL_DEBUG("Subgroup size: {}, compute subgroup votes: {}",
+              subgroupProperties.subgroupSize,
+              mHasSubgroupVote ? "supported" : "unsupported");
+
     vk::StructureChain<vk::PhysicalDeviceFeatures2,
                        vk::PhysicalDeviceVulkan11Features,
                        vk::PhysicalDeviceVulkan13Features,
@@ -404,6 +442,19 @@ void Renderer::createLogicalDevice() {
             {.swapchainMaintenance1 = VK_TRUE},
     };
 
+    // NOTE: Optional, without it GPU timestamps are aligned to the CPU
+    // timeline from fence signals, which is off by the wake-up latency
+    std::vector<const char *> deviceExtensions = RequiredDeviceExtensions;
+    const auto availableExtensions =
+        mPhysicalDevice.enumerateDeviceExtensionProperties();
+    mHasCalibratedTimestamps = std::ranges::any_of(
+        availableExtensions, [](const vk::ExtensionProperties &ext) {
+            return strcmp(ext.extensionName,
+                          vk::EXTCalibratedTimestampsExtensionName) == 0;
+        });
+    if (mHasCalibratedTimestamps)
+        deviceExtensions.push_back(vk::EXTCalibratedTimestampsExtensionName);
+
     float queuePriority = 0.0f;
     vk::DeviceQueueCreateInfo deviceQueueCreateInfo {
         .queueFamilyIndex = graphicsIndex,
@@ -416,8 +467,8 @@ void Renderer::createLogicalDevice() {
         .queueCreateInfoCount = 1,
         .pQueueCreateInfos    = &deviceQueueCreateInfo,
         .enabledExtensionCount =
-            static_cast<uint32_t>(RequiredDeviceExtensions.size()),
-        .ppEnabledExtensionNames = RequiredDeviceExtensions.data()};
+            static_cast<uint32_t>(deviceExtensions.size()),
+        .ppEnabledExtensionNames = deviceExtensions.data()};
 
     mDevice = vk::raii::Device(mPhysicalDevice, deviceCreateInfo);
     FTL_DEBUG("Created the Vulkan Logical Device!");
@@ -429,7 +480,7 @@ void Renderer::createLogicalDevice() {
     FTL_DEBUG("Created the Vulkan Present Queue!");
 };
 
-void Renderer::createSwapChain(GLFWwindow *pWindow) {
+void Renderer::createSwapChain(const WindowData *pWinData) {
     GTFO_PROFILE_FUNCTION();
     vk::SurfaceCapabilitiesKHR surfaceCapabilites =
         mPhysicalDevice.getSurfaceCapabilitiesKHR(mSurface);
@@ -438,7 +489,7 @@ void Renderer::createSwapChain(GLFWwindow *pWindow) {
         mPhysicalDevice.getSurfaceFormatsKHR(mSurface));
 
     mSwapChainFormat       = surfaceFormat.format;
-    mSwapChainExtent       = getSwapChainExtent(surfaceCapabilites, pWindow);
+    mSwapChainExtent       = getSwapChainExtent(surfaceCapabilites, pWinData);
 
     uint32_t minImageCount = std::max(3u, surfaceCapabilites.minImageCount);
     if (surfaceCapabilites.maxImageCount > 0 &&
@@ -486,6 +537,27 @@ void Renderer::createImageViews() {
     FTL_DEBUG("Vulkan Image Views created successfully!");
 };
 
+void Renderer::createDescriptorSetLayout() {
+    GTFO_PROFILE_FUNCTION();
+    const std::array<vk::DescriptorSetLayoutBinding, 2> bindings {
+        {{.binding         = 0, // iteration counts
+          .descriptorType  = vk::DescriptorType::eStorageBuffer,
+          .descriptorCount = 1,
+          .stageFlags      = vk::ShaderStageFlagBits::eCompute |
+                        vk::ShaderStageFlagBits::eFragment},
+         {.binding         = 1, // persistent kernel work counter
+          .descriptorType  = vk::DescriptorType::eStorageBuffer,
+          .descriptorCount = 1,
+          .stageFlags      = vk::ShaderStageFlagBits::eCompute}}
+    };
+
+    vk::DescriptorSetLayoutCreateInfo createInfo {
+        .bindingCount = static_cast<uint32_t>(bindings.size()),
+        .pBindings    = bindings.data()};
+
+    mDescriptorSetLayout = vk::raii::DescriptorSetLayout(mDevice, createInfo);
+};
+
 void Renderer::createGraphicsPipeline() {
     GTFO_PROFILE_FUNCTION();
     std::string shaderPath       = std::string(std::filesystem::current_path());
@@ -523,7 +595,7 @@ void Renderer::createGraphicsPipeline() {
         .depthClampEnable        = vk::False,
         .rasterizerDiscardEnable = vk::False,
         .polygonMode             = vk::PolygonMode::eFill,
-        .cullMode                = vk::CullModeFlagBits::eBack,
+        .cullMode                = vk::CullModeFlagBits::eNone,
         .frontFace               = vk::FrontFace::eClockwise,
         .depthBiasEnable         = vk::False,
         .depthBiasSlopeFactor    = 1.0f,
@@ -554,8 +626,18 @@ void Renderer::createGraphicsPipeline() {
         .dynamicStateCount = static_cast<uint32_t>(dynamicStates.size()),
         .pDynamicStates    = dynamicStates.data()};
 
+    // NOTE: Shared by the graphics pass and the escape kernels
+    vk::PushConstantRange pushConstantRange {
+        .stageFlags =
+            vk::ShaderStageFlagBits::eCompute | vk::ShaderStageFlagBits::eFragment,
+        .offset = 0,
+        .size   = sizeof(FractalParams)};
+
     vk::PipelineLayoutCreateInfo pipelineLayoutCreateInfo {
-        .setLayoutCount = 0, .pushConstantRangeCount = 0};
+        .setLayoutCount         = 1,
+        .pSetLayouts            = &*mDescriptorSetLayout,
+        .pushConstantRangeCount = 1,
+        .pPushConstantRanges    = &pushConstantRange};
 
     mPipelineLayout =
         vk::raii::PipelineLayout(mDevice, pipelineLayoutCreateInfo);
@@ -587,6 +669,120 @@ void Renderer::createGraphicsPipeline() {
     FTL_DEBUG("Vulkan Graphics Pipeline Successfully Created!");
 };
 
+void Renderer::createComputePipelines() {
+    GTFO_PROFILE_FUNCTION();
+    std::string shaderPath = std::string(std::filesystem::current_path());
+    shaderPath = shaderPath + (mHasSubgroupVote
+                                   ? "/assets/shaders/fractal_subgroup.spv"
+                                   : "/assets/shaders/fractal.spv");
+
+    std::vector<char> shaderCode = readFile(shaderPath);
+    vk::ShaderModuleCreateInfo shaderCreateInfo {
+        .codeSize = shaderCode.size() * sizeof(char),
+        .pCode    = reinterpret_cast<const uint32_t *>(shaderCode.data())};
+
+    vk::raii::ShaderModule shaderModule {mDevice, shaderCreateInfo};
+
+    vk::ComputePipelineCreateInfo pipelineCreateInfo {
+        .stage  = {.stage  = vk::ShaderStageFlagBits::eCompute,
+                   .module = shaderModule,
+                   .pName  = "computeMain"},
+        .layout = mPipelineLayout};
+
+    mNaiveKernelPipeline =
+        vk::raii::Pipeline(mDevice, nullptr, pipelineCreateInfo);
+
+    pipelineCreateInfo.stage.pName = "computePersistentMain";
+    mPersistentKernelPipeline =
+        vk::raii::Pipeline(mDevice, nullptr, pipelineCreateInfo);
+
+    FTL_DEBUG("Vulkan Compute Pipelines Successfully Created!");
+};
+
+void Renderer::createBuffer(vk::DeviceSize size, vk::BufferUsageFlags usage,
+                            vk::MemoryPropertyFlags properties,
+                            vk::raii::Buffer &buffer,
+                            vk::raii::DeviceMemory &memory) {
+    vk::BufferCreateInfo createInfo {.size        = size,
+                                     .usage       = usage,
+                                     .sharingMode = vk::SharingMode::eExclusive};
+    buffer = vk::raii::Buffer(mDevice, createInfo);
+
+    vk::MemoryRequirements requirements = buffer.getMemoryRequirements();
+    vk::MemoryAllocateInfo allocInfo {
+        .allocationSize  = requirements.size,
+        .memoryTypeIndex = findMemoryType(mPhysicalDevice.getMemoryProperties(),
+                                          requirements.memoryTypeBits,
+                                          properties)};
+
+    memory = vk::raii::DeviceMemory(mDevice, allocInfo);
+    buffer.bindMemory(*memory, 0);
+};
+
+void Renderer::createStorageBuffers() {
+    GTFO_PROFILE_FUNCTION();
+    const vk::DeviceSize iterationBufferSize =
+        static_cast<vk::DeviceSize>(mSwapChainExtent.width) *
+        mSwapChainExtent.height * sizeof(uint32_t);
+
+    // NOTE: Transfer source for readIterations()
+    createBuffer(iterationBufferSize,
+                 vk::BufferUsageFlagBits::eStorageBuffer |
+                     vk::BufferUsageFlagBits::eTransferSrc,
+                 vk::MemoryPropertyFlagBits::eDeviceLocal, mIterationBuffer,
+                 mIterationMemory);
+
+    createBuffer(sizeof(uint32_t),
+                 vk::BufferUsageFlagBits::eStorageBuffer |
+                     vk::BufferUsageFlagBits::eTransferDst,
+                 vk::MemoryPropertyFlagBits::eDeviceLocal, mWorkCounterBuffer,
+                 mWorkCounterMemory);
+
+    FTL_DEBUG("Vulkan Storage Buffers created successfully!");
+};
+
+void Renderer::createDescriptorSets() {
+    GTFO_PROFILE_FUNCTION();
+    vk::DescriptorPoolSize poolSize {
+        .type = vk::DescriptorType::eStorageBuffer, .descriptorCount = 2};
+
+    vk::DescriptorPoolCreateInfo poolCreateInfo {
+        .flags         = vk::DescriptorPoolCreateFlagBits::eFreeDescriptorSet,
+        .maxSets       = 1,
+        .poolSizeCount = 1,
+        .pPoolSizes    = &poolSize};
+
+    mDescriptorPool = vk::raii::DescriptorPool(mDevice, poolCreateInfo);
+
+    vk::DescriptorSetAllocateInfo allocInfo {
+        .descriptorPool     = mDescriptorPool,
+        .descriptorSetCount = 1,
+        .pSetLayouts        = &*mDescriptorSetLayout};
+
+    mDescriptorSet =
+        std::move(vk::raii::DescriptorSets(mDevice, allocInfo).front());
+
+    const vk::DescriptorBufferInfo iterationInfo {
+        .buffer = mIterationBuffer, .offset = 0, .range = vk::WholeSize};
+    const vk::DescriptorBufferInfo workCounterInfo {
+        .buffer = mWorkCounterBuffer, .offset = 0, .range = vk::WholeSize};
+
+    const std::array<vk::WriteDescriptorSet, 2> writes {
+        {{.dstSet          = mDescriptorSet,
+          .dstBinding      = 0,
+          .descriptorCount = 1,
+          .descriptorType  = vk::DescriptorType::eStorageBuffer,
+          .pBufferInfo     = &iterationInfo},
+         {.dstSet          = mDescriptorSet,
+          .dstBinding      = 1,
+          .descriptorCount = 1,
+          .descriptorType  = vk::DescriptorType::eStorageBuffer,
+          .pBufferInfo     = &workCounterInfo}}
+    };
+
+    mDevice.updateDescriptorSets(writes, {});
+};
+
 void Renderer::createCommandPool() {
     vk::CommandPoolCreateInfo createInfo {
         .flags            = vk::CommandPoolCreateFlagBits::eResetCommandBuffer,
@@ -605,8 +801,92 @@ void Renderer::createCommandBuffer() {
         std::move(vk::raii::CommandBuffers(mDevice, allocInfo).front());
 };
 
-void Renderer::recordCommandBuffer(uint32_t imageIndex) {
+void Renderer::recordEscapeKernel(const FractalParams &params) {
+    GTFO_PROFILE_FUNCTION();
+    const uint32_t width  = params.extent[0];
+    const uint32_t height = params.extent[1];
+
+    if (mKernelMode == KernelMode::Persistent) {
+        mCommandBuffer.fillBuffer(mWorkCounterBuffer, 0, sizeof(uint32_t), 0);
+
+        const vk::BufferMemoryBarrier2 counterBarrier {
+            .srcStageMask        = vk::PipelineStageFlagBits2::eTransfer,
+            .srcAccessMask       = vk::AccessFlagBits2::eTransferWrite,
+            .dstStageMask        = vk::PipelineStageFlagBits2::eComputeShader,
+            .dstAccessMask       = vk::AccessFlagBits2::eShaderStorageRead |
+                             vk::AccessFlagBits2::eShaderStorageWrite,
+            .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .buffer              = mWorkCounterBuffer,
+            .offset              = 0,
+            .size                = vk::WholeSize};
+
+        mCommandBuffer.pipelineBarrier2({.bufferMemoryBarrierCount = 1,
+                                         .pBufferMemoryBarriers =
+                                             &counterBarrier});
+
+        const uint32_t tileCount =
+            ((width + PersistentTileSize - 1) / PersistentTileSize) *
+            ((height + PersistentTileSize - 1) / PersistentTileSize);
+
+        mCommandBuffer.bindPipeline(vk::PipelineBindPoint::eCompute,
+                                    mPersistentKernelPipeline);
+        mCommandBuffer.dispatch(std::min(tileCount, PersistentWorkgroupCount),
+                                1, 1);
+    } else {
+        mCommandBuffer.bindPipeline(vk::PipelineBindPoint::eCompute,
+                                    mNaiveKernelPipeline);
+        mCommandBuffer.dispatch(
+            (width + NaiveWorkgroupSize - 1) / NaiveWorkgroupSize,
+            (height + NaiveWorkgroupSize - 1) / NaiveWorkgroupSize, 1);
+    };
+
+    // NOTE: The fragment stage reads the iteration counts written above
+    const vk::BufferMemoryBarrier2 iterationBarrier {
+        .srcStageMask        = vk::PipelineStageFlagBits2::eComputeShader,
+        .srcAccessMask       = vk::AccessFlagBits2::eShaderStorageWrite,
+        .dstStageMask        = vk::PipelineStageFlagBits2::eFragmentShader,
+        .dstAccessMask       = vk::AccessFlagBits2::eShaderStorageRead,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .buffer              = mIterationBuffer,
+        .offset              = 0,
+        .size                = vk::WholeSize};
+
+    mCommandBuffer.pipelineBarrier2(
+        {.bufferMemoryBarrierCount = 1,
+         .pBufferMemoryBarriers    = &iterationBarrier});
+};
+
+void Renderer::recordCommandBuffer(uint32_t imageIndex,
+                                   vk::Extent2D renderExtent) {
     mCommandBuffer.begin({});
+    mGpuProfiler.beginFrame(mDevice, mCommandBuffer);
+
+    // NOTE: Must be the first GPU scope, the profiler reads the frame time
+    // from scope 0
+    mGpuProfiler.beginScope(mCommandBuffer, "Frame");
+
+    const FractalParams params {
+        .center        = {static_cast<float>(mView.centerX),
+                          static_cast<float>(mView.centerY)},
+        .height        = static_cast<float>(mView.height),
+        .maxIterations = mView.maxIterations,
+        .extent        = {renderExtent.width, renderExtent.height},
+        .outputExtent  = {mSwapChainExtent.width, mSwapChainExtent.height}
+    };
+
+    mCommandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute,
+                                      mPipelineLayout, 0, *mDescriptorSet, {});
+    mCommandBuffer.pushConstants<FractalParams>(
+        mPipelineLayout,
+        vk::ShaderStageFlagBits::eCompute | vk::ShaderStageFlagBits::eFragment,
+        0, params);
+
+    {
+        GpuScope kernelScope(mGpuProfiler, mCommandBuffer, "Escape Kernel");
+        recordEscapeKernel(params);
+    }
 
     transitionImageLayout(
         imageIndex, vk::ImageLayout::eUndefined,
@@ -632,18 +912,25 @@ void Renderer::recordCommandBuffer(uint32_t imageIndex) {
         .pColorAttachments    = &attachmentInfo
     };
 
-    mCommandBuffer.beginRendering(renderingInfo);
-    mCommandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics,
-                                mGraphicsPipeline);
-    mCommandBuffer.setViewport(
-        0,
-        vk::Viewport(0.0f, 0.0f, static_cast<float>(mSwapChainExtent.width),
-                     static_cast<float>(mSwapChainExtent.height), 0.0f, 1.0f));
-
-    mCommandBuffer.setScissor(0,
-                              vk::Rect2D(vk::Offset2D(0, 0), mSwapChainExtent));
-    mCommandBuffer.draw(3, 1, 0, 0);
-    mCommandBuffer.endRendering();
+    {
+        GpuScope passScope(mGpuProfiler, mCommandBuffer, "Fullscreen Pass");
+        mCommandBuffer.beginRendering(renderingInfo);
+        mCommandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics,
+                                    mGraphicsPipeline);
+        mCommandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics,
+                                          mPipelineLayout, 0, *mDescriptorSet,
+                                          {});
+        mCommandBuffer.setViewport(
+            0, vk::Viewport(0.0f, 0.0f,
+                            static_cast<float>(mSwapChainExtent.width),
+                            static_cast<float>(mSwapChainExtent.height), 0.0f,
+                            1.0f));
+
+        mCommandBuffer.setScissor(
+            0, vk::Rect2D(vk::Offset2D(0, 0), mSwapChainExtent));
+        mCommandBuffer.draw(3, 1, 0, 0);
+        mCommandBuffer.endRendering();
+    }
 
     transitionImageLayout(
         imageIndex, vk::ImageLayout::eColorAttachmentOptimal,
@@ -654,6 +941,8 @@ void Renderer::recordCommandBuffer(uint32_t imageIndex) {
         vk::PipelineStageFlagBits2::eBottomOfPipe           // dstStage
     );
 
+    mGpuProfiler.endScope(mCommandBuffer);
+    mGpuProfiler.endFrame();
     mCommandBuffer.end();
 };
 
@@ -668,12 +957,32 @@ void Renderer::createSyncObjects() {
         vk::raii::Fence(mDevice, {.flags = vk::FenceCreateFlagBits::eSignaled});
 };
 
-void Renderer::render() {
+void Renderer::createGpuProfiler() {
+    GTFO_PROFILE_FUNCTION();
+    mGpuProfiler.init(mPhysicalDevice, mDevice, mGraphicsQueueIndex,
+                      mHasCalibratedTimestamps);
+};
+
+FrameStats Renderer::render() {
+    GTFO_PROFILE_FRAME("Frame");
     GTFO_PROFILE_FUNCTION();
+    const auto startTime      = std::chrono::steady_clock::now();
     auto [result, imageIndex] = mSwapChain.acquireNextImage(
         UINT64_MAX, *mSemaphorePresentComplete, nullptr);
 
-    recordCommandBuffer(imageIndex);
+    // NOTE: Interactive frames follow the frame-time budget, once the view
+    // settles a single full resolution pass replaces the scaled image.
+    const bool isRefinementPass = !mIsDirty && mNeedsRefinement;
+    const float scale           = (isRefinementPass || mIsBenchmark)
+                                      ? 1.0f
+                                      : mResolutionController.scale();
+    const vk::Extent2D renderExtent {
+        .width  = std::max(1u, static_cast<uint32_t>(
+                                   std::lround(mSwapChainExtent.width * scale))),
+        .height = std::max(1u, static_cast<uint32_t>(std::lround(
+                                   mSwapChainExtent.height * scale)))};
+
+    recordCommandBuffer(imageIndex, renderExtent);
 
     mDevice.resetFences(*mFenceDraw);
 
@@ -689,11 +998,35 @@ void Renderer::render() {
         .signalSemaphoreCount = 1,
         .pSignalSemaphores    = &*mSemaphoreRenderFinished};
 
+    // NOTE: Submit-to-signal wall time includes the wait on the swap chain
+    // image, it only stands in for GPU time when there are no timestamps
+    const auto submitTime = std::chrono::steady_clock::now();
     mGraphicsQueue.submit(submitInfo, *mFenceDraw);
     while (vk::Result::eTimeout ==
            mDevice.waitForFences(*mFenceDraw, vk::True, UINT64_MAX))
         ;
 
+    const std::chrono::duration<double, std::milli> frameTime =
+        std::chrono::steady_clock::now() - submitTime;
+
+    // The fence has signaled, so this frame's timestamps are ready now
+    mGpuProfiler.frameComplete();
+    const bool hasGpuTime = mGpuProfiler.resolveCompleted(mDevice);
+    const double gpuTime  = hasGpuTime ? mGpuProfiler.lastFrameMs() : 0.0;
+    const double frameMs  = hasGpuTime ? gpuTime : frameTime.count();
+    if (!mIsBenchmark && !isRefinementPass)
+        mResolutionController.update(frameMs);
+
+    const double megapixels =
+        static_cast<double>(renderExtent.width) * renderExtent.height / 1e6;
+    GTFO_PROFILE_COUNTER("Render Scale", scale);
+    GTFO_PROFILE_COUNTER("Max Iterations", mView.maxIterations);
+    GTFO_PROFILE_COUNTER("GPU Frame ms", gpuTime);
+    GTFO_PROFILE_COUNTER("Megapixels/s", megapixels * 1e3 / frameMs);
+    FTL_TRACE("Frame {}x{} at scale {:.3f}, {} iterations, {:.3f} ms",
+              renderExtent.width, renderExtent.height, scale,
+              mView.maxIterations, frameMs);
+
     const vk::PresentInfoKHR presentInfoKHR {.waitSemaphoreCount = 1,
                                              .pWaitSemaphores =
                                                  &*mSemaphoreRenderFinished,
@@ -701,7 +1034,144 @@ void Renderer::render() {
                                              .pSwapchains    = &*mSwapChain,
                                              .pImageIndices  = &imageIndex};
 
-    result = mGraphicsQueue.presentKHR(presentInfoKHR);
+    result           = mGraphicsQueue.presentKHR(presentInfoKHR);
+    mIsDirty         = false;
+    mNeedsRefinement = (scale < 1.0f);
+
+    const std::chrono::duration<double, std::milli> cpuTime =
+        std::chrono::steady_clock::now() - startTime;
+    return {.cpuMs         = cpuTime.count(),
+            .submitMs      = frameTime.count(),
+            .gpuMs         = gpuTime,
+            .extent        = renderExtent,
+            .maxIterations = mView.maxIterations};
+};
+
+std::vector<uint32_t> Renderer::readIterations() {
+    GTFO_PROFILE_FUNCTION();
+    const vk::DeviceSize size =
+        static_cast<vk::DeviceSize>(mSwapChainExtent.width) *
+        mSwapChainExtent.height * sizeof(uint32_t);
+
+    if (!*mReadbackBuffer) {
+        createBuffer(size, vk::BufferUsageFlagBits::eTransferDst,
+                     vk::MemoryPropertyFlagBits::eHostVisible |
+                         vk::MemoryPropertyFlagBits::eHostCoherent,
+                     mReadbackBuffer, mReadbackMemory);
+    };
+
+    const vk::CommandBufferAllocateInfo allocInfo {
+        .commandPool        = mCommandPool,
+        .level              = vk::CommandBufferLevel::ePrimary,
+        .commandBufferCount = 1};
+    vk::raii::CommandBuffer commandBuffer =
+        std::move(vk::raii::CommandBuffers(mDevice, allocInfo).front());
+
+    // NOTE: The kernel's writes happened in an earlier submission, the
+    // barriers still order them since submission order spans submits
+    const std::array<vk::BufferMemoryBarrier2, 2> barriers {
+        {{.srcStageMask        = vk::PipelineStageFlagBits2::eComputeShader,
+          .srcAccessMask       = vk::AccessFlagBits2::eShaderStorageWrite,
+          .dstStageMask        = vk::PipelineStageFlagBits2::eTransfer,
+          .dstAccessMask       = vk::AccessFlagBits2::eTransferRead,
+          .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+          .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+          .buffer              = mIterationBuffer,
+          .offset              = 0,
+          .size                = vk::WholeSize},
+         {.srcStageMask        = vk::PipelineStageFlagBits2::eTransfer,
+          .srcAccessMask       = vk::AccessFlagBits2::eTransferWrite,
+          .dstStageMask        = vk::PipelineStageFlagBits2::eHost,
+          .dstAccessMask       = vk::AccessFlagBits2::eHostRead,
+          .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+          .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+          .buffer              = mReadbackBuffer,
+          .offset              = 0,
+          .size                = vk::WholeSize}}
+    };
+
+    commandBuffer.begin(
+        {.flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit});
+    commandBuffer.pipelineBarrier2({.bufferMemoryBarrierCount = 1,
+                                    .pBufferMemoryBarriers = &barriers[0]});
+    commandBuffer.copyBuffer(mIterationBuffer, mReadbackBuffer,
+                             vk::BufferCopy {.size = size});
+    commandBuffer.pipelineBarrier2({.bufferMemoryBarrierCount = 1,
+                                    .pBufferMemoryBarriers = &barriers[1]});
+    commandBuffer.end();
+
+    mGraphicsQueue.submit(vk::SubmitInfo {.commandBufferCount = 1,
+                                          .pCommandBuffers = &*commandBuffer},
+                          nullptr);
+    mGraphicsQueue.waitIdle();
+
+    std::vector<uint32_t> iterations(size / sizeof(uint32_t));
+    const void *pData = mReadbackMemory.mapMemory(0, size);
+    std::memcpy(iterations.data(), pData, size);
+    mReadbackMemory.unmapMemory();
+    return iterations;
+};
+
+std::string Renderer::deviceName() const {
+    return mPhysicalDevice.getProperties().deviceName;
+};
+
+std::string Renderer::driverInfo() const {
+    const auto chain =
+        mPhysicalDevice.getProperties2<vk::PhysicalDeviceProperties2,
+                                       vk::PhysicalDeviceDriverProperties>();
+    const auto &driver = chain.get<vk::PhysicalDeviceDriverProperties>();
+    return std::string(driver.driverName) + " " +
+           std::string(driver.driverInfo);
+};
+
+void Renderer::applyCommand(const ViewCommand &command) {
+    const double unitsPerPixel =
+        mView.height / static_cast<double>(mSwapChainExtent.height);
+
+    switch (command.type) {
+    case ViewCommandType::Pan:
+        mView.centerX -= command.x * unitsPerPixel;
+        mView.centerY -= command.y * unitsPerPixel;
+        break;
+
+    case ViewCommandType::Zoom: {
+        // NOTE: Keep the complex point under the anchor pixel fixed on screen
+        const double anchorX =
+            (command.x - 0.5 * mSwapChainExtent.width) * unitsPerPixel;
+        const double anchorY =
+            (command.y - 0.5 * mSwapChainExtent.height) * unitsPerPixel;
+        const double factor  = 1.0 / command.value;
+
+        mView.centerX       += anchorX * (1.0 - factor);
+        mView.centerY       += anchorY * (1.0 - factor);
+        mView.height        *= factor;
+        break;
+    }
+
+    case ViewCommandType::ScaleIterations:
+        mView.maxIterations = std::max(
+            1u, static_cast<uint32_t>(mView.maxIterations * command.value));
+        FTL_DEBUG("Iteration limit set to {}", mView.maxIterations);
+        break;
+
+    case ViewCommandType::Reset:
+        mView = View {};
+        break;
+
+    case ViewCommandType::ToggleKernel:
+        mKernelMode = (mKernelMode == KernelMode::Naive) ? KernelMode::Persistent
+                                                         : KernelMode::Naive;
+        FTL_DEBUG("Escape kernel: {}", mKernelMode == KernelMode::Persistent
+                                           ? "persistent"
+                                           : "naive");
+        break;
+
+    default:
+        break;
+    };
+
+    invalidate();
 };
 
 void Renderer::transitionImageLayout(uint32_t imageIndex,
@@ -735,6 +1205,13 @@ void Renderer::transitionImageLayout(uint32_t imageIndex,
 }
 
 void Renderer::shutdown(GLFWwindow **ppWindow) {
+    if (hasValidationLayerSupport)
+        mDebugMessageRouter.logSummary();
+
+    // NOTE: Headless renderers never initialized GLFW
+    if (*ppWindow == nullptr)
+        return;
+
     glfwDestroyWindow(*ppWindow);
     glfwTerminate();
 };
@@ -1,18 +1,46 @@
 #pragma once
 
+#include "FTL_DebugMessageRouter.h"
+#include "FTL_GpuProfiler.h"
+#include "FTL_ResolutionController.h"
 #include "gtfo_profiler.h"
 #include <core/FTL_Window.h>
 #include <utility/FTL_Log.h>
+#include <utility/FTL_Types.h>
 #include <utility/FTL_pch.h>
 
 namespace FTL {
 
 struct VulkanCore {};
 
+// NOTE: Must match FractalParams in assets/shaders/fractal.slang & shader.slang
+struct FractalParams {
+    float center[2];
+    float height;
+    uint32_t maxIterations;
+    uint32_t extent[2];       // render extent, dynamic resolution
+    uint32_t outputExtent[2]; // swap chain extent
+};
+
+enum class KernelMode : uint8_t {
+    Naive,      // one invocation per pixel
+    Persistent, // fixed workgroups pulling tiles from an atomic counter
+};
+
+// NOTE: Timings of a single render() call
+struct FrameStats {
+    double cpuMs {0.0};    // acquire to present
+    double submitMs {0.0}; // submit to fence signal
+    double gpuMs {0.0};    // GPU timestamps, 0 when the queue has none
+    vk::Extent2D extent {};
+    uint32_t maxIterations {0};
+};
+
 class Renderer {
   private:
     vk::raii::Context mContext;
     vk::raii::Instance mInstance {nullptr};
+    DebugMessageRouter mDebugMessageRouter {}; // Outlives the messenger
     vk::raii::DebugUtilsMessengerEXT mDebugMessenger {nullptr};
     vk::raii::SurfaceKHR mSurface {nullptr};
     vk::raii::PhysicalDevice mPhysicalDevice {nullptr};
@@ -30,8 +58,24 @@ class Renderer {
     std::vector<vk::Image> mSwapChainImages {};
     std::vector<vk::raii::ImageView> mSwapChainImageViews {};
 
+    vk::raii::DescriptorSetLayout mDescriptorSetLayout {nullptr};
     vk::raii::PipelineLayout mPipelineLayout {nullptr};
     vk::raii::Pipeline mGraphicsPipeline {nullptr};
+    vk::raii::Pipeline mNaiveKernelPipeline {nullptr};
+    vk::raii::Pipeline mPersistentKernelPipeline {nullptr};
+    KernelMode mKernelMode {KernelMode::Naive};
+    bool mHasSubgroupVote {false};
+    bool mHasCalibratedTimestamps {false};
+
+    vk::raii::Buffer mIterationBuffer {nullptr};
+    vk::raii::DeviceMemory mIterationMemory {nullptr};
+    vk::raii::Buffer mWorkCounterBuffer {nullptr};
+    vk::raii::DeviceMemory mWorkCounterMemory {nullptr};
+    vk::raii::Buffer mReadbackBuffer {nullptr}; // Created by readIterations()
+    vk::raii::DeviceMemory mReadbackMemory {nullptr};
+
+    vk::raii::DescriptorPool mDescriptorPool {nullptr};
+    vk::raii::DescriptorSet mDescriptorSet {nullptr};
 
     vk::raii::CommandPool mCommandPool {nullptr};
     vk::raii::CommandBuffer mCommandBuffer {nullptr};
@@ -40,19 +84,45 @@ class Renderer {
     vk::raii::Semaphore mSemaphoreRenderFinished {nullptr};
     vk::raii::Fence mFenceDraw {nullptr};
 
+    // NOTE: Set whenever the presented image no longer matches what would be
+    // rendered now. Cleared once a frame has been submitted and presented.
+    bool mIsDirty {true};
+    bool mNeedsRefinement {false};
+    View mView {};
+
+    // NOTE: Renders every frame at full resolution and reads GPU timestamps
+    // back right away, so frames are comparable between runs
+    bool mIsBenchmark {false};
+
+    // NOTE: The iteration buffer is sized for the swap chain extent, scaled
+    // frames only use its first width * height entries, so changing the
+    // scale never reallocates it.
+    ResolutionController mResolutionController;
+    GpuProfiler mGpuProfiler {};
+
     void createInstance(WindowData *pWinData);
     void setupDebugMessenger();
-    void createSurface(GLFWwindow *pWindow);
+    void createSurface(const WindowData *pWinData);
     void pickPhysicalDevice();
     void createLogicalDevice();
-    void createSwapChain(GLFWwindow *pWindow);
+    void createSwapChain(const WindowData *pWinData);
     void createImageViews();
+    void createDescriptorSetLayout();
     void createGraphicsPipeline();
+    void createComputePipelines();
+    void createStorageBuffers();
+    void createDescriptorSets();
     void createCommandPool();
     void createCommandBuffer();
     void createSyncObjects();
+    void createGpuProfiler();
+
+    void createBuffer(vk::DeviceSize size, vk::BufferUsageFlags usage,
+                      vk::MemoryPropertyFlags properties,
+                      vk::raii::Buffer &buffer, vk::raii::DeviceMemory &memory);
 
-    void recordCommandBuffer(uint32_t imageIndex);
+    void recordCommandBuffer(uint32_t imageIndex, vk::Extent2D renderExtent);
+    void recordEscapeKernel(const FractalParams &params);
     void transitionImageLayout(uint32_t imageIndex, vk::ImageLayout oldLayout,
                                vk::ImageLayout newLayout,
                                vk::AccessFlags2 srcAccessMask,
@@ -69,18 +139,46 @@ class Renderer {
         GTFO_PROFILE_SCOPE("Vulkan Init", "init");
         createInstance(pWinData);
         setupDebugMessenger();
-        createSurface(pWinData->window);
+        createSurface(pWinData);
         pickPhysicalDevice();
         createLogicalDevice();
-        createSwapChain(pWinData->window);
+        createSwapChain(pWinData);
         createImageViews();
+        createDescriptorSetLayout();
         createGraphicsPipeline();
+        createComputePipelines();
+        createStorageBuffers();
+        createDescriptorSets();
         createCommandPool();
         createCommandBuffer();
         createSyncObjects();
+        createGpuProfiler();
     };
 
-    void render();
+    FrameStats render();
     void waitIdle() const { mDevice.waitIdle(); };
+
+    void applyCommand(const ViewCommand &command);
+    void invalidate() { mIsDirty = true; };
+    bool hasPendingWork() const { return mIsDirty || mNeedsRefinement; };
+
+    const View &view() const { return mView; };
+    void setView(const View &view) {
+        mView = view;
+        invalidate();
+    };
+    void setKernelMode(KernelMode mode) {
+        mKernelMode = mode;
+        invalidate();
+    };
+    void setBenchmarkMode(bool isBenchmark) { mIsBenchmark = isBenchmark; };
+
+    // NOTE: Copies the last frame's iteration counts to the host and waits
+    // for the copy. Entry y * extent.width + x belongs to pixel (x, y) of
+    // the frame's render extent, anything past it is stale.
+    std::vector<uint32_t> readIterations();
+
+    std::string deviceName() const;
+    std::string driverInfo() const;
 };
 }; // namespace FTL
@@ -0,0 +1,60 @@
+#include "FTL_ResolutionController.h"
+#include <utility/FTL_Log.h>
+
+namespace {
+constexpr double AverageWeight     = 0.2;
+
+// Frames the average must stay over (under) budget before stepping
+constexpr uint32_t DownscaleFrames = 3;
+constexpr uint32_t UpscaleFrames   = 15;
+
+// NOTE: Only step up when the next scale is predicted to leave headroom,
+// otherwise the controller would bounce between two neighbouring steps.
+constexpr double UpscaleHeadroom   = 0.8;
+
+// Escape-time cost grows with the pixel count, i.e. the square of the scale
+double predictFrameTime(double frameTimeMs, float fromScale, float toScale) {
+    const double ratio = static_cast<double>(toScale) / fromScale;
+    return frameTimeMs * ratio * ratio;
+};
+}; // namespace
+
+namespace FTL {
+ResolutionController::ResolutionController(double budgetMs)
+    : mBudgetMs(budgetMs) {};
+
+void ResolutionController::update(double frameTimeMs) {
+    mAverageMs = (mAverageMs == 0.0)
+                     ? frameTimeMs
+                     : mAverageMs + AverageWeight * (frameTimeMs - mAverageMs);
+
+    if (mAverageMs > mBudgetMs) {
+        mUnderBudgetFrames = 0;
+        if (++mOverBudgetFrames >= DownscaleFrames && mStepIndex > 0)
+            setStep(mStepIndex - 1);
+        return;
+    };
+
+    mOverBudgetFrames = 0;
+    if (mStepIndex + 1 >= ScaleSteps.size())
+        return;
+
+    const double predictedMs =
+        predictFrameTime(mAverageMs, scale(), ScaleSteps[mStepIndex + 1]);
+    if (predictedMs < mBudgetMs * UpscaleHeadroom) {
+        if (++mUnderBudgetFrames >= UpscaleFrames)
+            setStep(mStepIndex + 1);
+    } else {
+        mUnderBudgetFrames = 0;
+    };
+};
+
+void ResolutionController::setStep(std::size_t stepIndex) {
+    mAverageMs = predictFrameTime(mAverageMs, scale(), ScaleSteps[stepIndex]);
+    mStepIndex = stepIndex;
+
+    mOverBudgetFrames  = 0;
+    mUnderBudgetFrames = 0;
+    FTL_DEBUG("Render scale set to {:.3f}", scale());
+};
+}; // namespace FTL
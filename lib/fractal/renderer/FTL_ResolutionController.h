@@ -0,0 +1,28 @@
+#pragma once
+
+#include <utility/FTL_pch.h>
+
+namespace FTL {
+// NOTE: Picks the render scale for the next frame from measured GPU frame
+// times. Scales are quantized and changes need several consecutive frames
+// on the same side of the budget, so the render extent does not flicker.
+class ResolutionController {
+  private:
+    static constexpr std::array<float, 7> ScaleSteps {
+        0.25f, 0.375f, 0.5f, 0.625f, 0.75f, 0.875f, 1.0f};
+
+    double mBudgetMs;
+    double mAverageMs {0.0};
+    std::size_t mStepIndex {ScaleSteps.size() - 1};
+    uint32_t mOverBudgetFrames {0};
+    uint32_t mUnderBudgetFrames {0};
+
+    void setStep(std::size_t stepIndex);
+
+  public:
+    explicit ResolutionController(double budgetMs);
+
+    void update(double frameTimeMs);
+    float scale() const { return ScaleSteps[mStepIndex]; };
+};
+}; // namespace FTL
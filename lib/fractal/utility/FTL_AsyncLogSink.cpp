@@ -0,0 +1,178 @@
+#include "FTL_AsyncLogSink.h"
+
+namespace {
+// NOTE: How long the writer sleeps when the ring is empty. Producers only
+// wake it early for flush-level records or a ring that is filling up.
+constexpr std::chrono::milliseconds WriterWakeInterval(10);
+}; // namespace
+
+namespace FTL {
+AsyncLogSink::AsyncLogSink(std::vector<spdlog::sink_ptr> sinks,
+                           const LogFlushPolicy &policy)
+    : mSinks(std::move(sinks)) {
+    setFlushPolicy(policy);
+};
+
+AsyncLogSink::~AsyncLogSink() { stop(); };
+
+void AsyncLogSink::start() {
+    if (mIsRunning.exchange(true))
+        return;
+
+    mWriterThread = std::thread(&AsyncLogSink::writerLoop, this);
+};
+
+void AsyncLogSink::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mWriterMutex);
+        if (!mIsRunning.exchange(false))
+            return;
+    }
+    mWriterSignal.notify_one();
+    mWriterThread.join();
+
+    // Producers that saw the writer running just before it stopped
+    bool shouldFlush = false;
+    while (writeBatch(shouldFlush) != 0) {
+    }
+    flushSinks();
+};
+
+void AsyncLogSink::setFlushPolicy(const LogFlushPolicy &policy) {
+    mFlushLevel.store(policy.level, std::memory_order_relaxed);
+    mFlushIntervalMs.store(policy.interval.count(), std::memory_order_relaxed);
+};
+
+void AsyncLogSink::log(const spdlog::details::log_msg &msg) {
+    if (!mIsRunning.load(std::memory_order_acquire)) {
+        std::lock_guard<std::mutex> lock(mDirectMutex);
+        for (const spdlog::sink_ptr &sink : mSinks) {
+            if (sink->should_log(msg.level))
+                sink->log(msg);
+        }
+        return;
+    }
+
+    const bool isPushed = mQueue.tryEmplace([&msg](LogRecord &record) {
+        record.time       = msg.time;
+        record.source     = msg.source;
+        record.loggerName = msg.logger_name;
+        record.threadId   = msg.thread_id;
+        record.level      = msg.level;
+        record.size       = static_cast<uint32_t>(msg.payload.size());
+
+        if (msg.payload.size() <= LogRecord::InlineSize) {
+            std::memcpy(record.text, msg.payload.data(), msg.payload.size());
+            record.overflow.clear();
+        } else {
+            record.overflow.assign(msg.payload.data(), msg.payload.size());
+        }
+    });
+
+    if (!isPushed) {
+        mDroppedCount.fetch_add(1, std::memory_order_relaxed);
+        mDroppedTotal.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    if (msg.level >= mFlushLevel.load(std::memory_order_relaxed) ||
+        mQueue.sizeApprox() > QueueCapacity / 2)
+        mWriterSignal.notify_one();
+};
+
+void AsyncLogSink::flush() {
+    mIsFlushRequested.store(true, std::memory_order_relaxed);
+    mWriterSignal.notify_one();
+};
+
+void AsyncLogSink::writerLoop() {
+    auto lastFlush = std::chrono::steady_clock::now();
+    bool isDirty   = false;
+
+    while (true) {
+        const bool isRunning = mIsRunning.load(std::memory_order_acquire);
+
+        bool shouldFlush        = false;
+        const std::size_t count = writeBatch(shouldFlush);
+        reportDropped();
+        isDirty |= (count != 0);
+
+        const auto now = std::chrono::steady_clock::now();
+        const std::chrono::milliseconds interval(
+            mFlushIntervalMs.load(std::memory_order_relaxed));
+        shouldFlush |= mIsFlushRequested.exchange(false);
+        if (isDirty && (shouldFlush || now - lastFlush >= interval)) {
+            flushSinks();
+            lastFlush = now;
+            isDirty   = false;
+        }
+
+        // A full batch means there is more waiting, a stop request is only
+        // honoured once a pass found the ring empty
+        if (count == MaxBatchSize)
+            continue;
+        if (!isRunning) {
+            if (isDirty)
+                flushSinks();
+            break;
+        }
+
+        std::unique_lock<std::mutex> lock(mWriterMutex);
+        mWriterSignal.wait_for(lock, WriterWakeInterval);
+    }
+};
+
+std::size_t AsyncLogSink::writeBatch(bool &shouldFlush) {
+    const spdlog::level::level_enum flushLevel =
+        mFlushLevel.load(std::memory_order_relaxed);
+
+    LogRecord record;
+    std::size_t count = 0;
+    while (count < MaxBatchSize && mQueue.tryPop(record)) {
+        writeRecord(record);
+        shouldFlush |= (record.level >= flushLevel);
+        count++;
+    }
+    return count;
+};
+
+void AsyncLogSink::writeRecord(const LogRecord &record) {
+    const spdlog::string_view_t payload =
+        record.overflow.empty()
+            ? spdlog::string_view_t(record.text, record.size)
+            : spdlog::string_view_t(record.overflow);
+
+    spdlog::details::log_msg msg(record.time, record.source,
+                                 record.loggerName, record.level, payload);
+    msg.thread_id = record.threadId;
+
+    std::lock_guard<std::mutex> lock(mDirectMutex);
+    for (const spdlog::sink_ptr &sink : mSinks) {
+        if (sink->should_log(msg.level))
+            sink->log(msg);
+    }
+};
+
+void AsyncLogSink::reportDropped() {
+    const uint64_t dropped =
+        mDroppedCount.exchange(0, std::memory_order_relaxed);
+    if (dropped == 0)
+        return;
+
+    const std::string text = fmt::format(
+        "{} log messages dropped, the log queue was full", dropped);
+
+    LogRecord record;
+    record.time       = spdlog::log_clock::now();
+    record.loggerName = "FTL::Log";
+    record.level      = spdlog::level::warn;
+    record.overflow   = text;
+    writeRecord(record);
+};
+
+void AsyncLogSink::flushSinks() {
+    std::lock_guard<std::mutex> lock(mDirectMutex);
+    for (const spdlog::sink_ptr &sink : mSinks)
+        sink->flush();
+};
+}; // namespace FTL
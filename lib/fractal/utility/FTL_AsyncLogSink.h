@@ -0,0 +1,97 @@
+#pragma once
+
+#include "FTL_MPSCQueue.h"
+#include "FTL_pch.h"
+
+#include <condition_variable>
+#include <mutex>
+
+namespace FTL {
+struct LogFlushPolicy {
+    // Records at or above this level flush the sinks right after the batch
+    // they arrive in, everything else waits for the interval
+    spdlog::level::level_enum level {spdlog::level::warn};
+    std::chrono::milliseconds interval {200};
+};
+
+// One formatted message, copied out of the caller's stack by the front end
+struct LogRecord {
+    static constexpr std::size_t InlineSize = 256;
+
+    spdlog::log_clock::time_point time;
+    spdlog::source_loc source;
+    spdlog::string_view_t loggerName;
+    std::size_t threadId {0};
+    spdlog::level::level_enum level {spdlog::level::trace};
+    uint32_t size {0};
+    char text[InlineSize];
+    std::string overflow; // Used instead of text when the message is longer
+};
+
+// NOTE: spdlog front end for a lock-free log pipeline. The logger formats
+// the message on the calling thread as usual, log() copies it into an MPSC
+// ring and returns, and a writer thread hands batches to the real sinks and
+// flushes them according to the LogFlushPolicy. A full ring drops the
+// message instead of waiting and the writer reports how many were lost.
+// The backend sinks are only touched by the writer, so they can be the
+// single-threaded (_st) variants.
+class AsyncLogSink final : public spdlog::sinks::sink {
+  public:
+    static constexpr std::size_t QueueCapacity = 4096;
+
+  private:
+    static constexpr std::size_t MaxBatchSize = 256;
+
+    MPSCQueue<LogRecord, QueueCapacity> mQueue;
+    std::vector<spdlog::sink_ptr> mSinks;
+
+    std::thread mWriterThread;
+    std::mutex mWriterMutex;
+    std::condition_variable mWriterSignal;
+    std::atomic<bool> mIsRunning {false};
+    std::atomic<bool> mIsFlushRequested {false};
+    std::atomic<uint64_t> mDroppedCount {0}; // Since the last report
+    std::atomic<uint64_t> mDroppedTotal {0};
+
+    std::atomic<spdlog::level::level_enum> mFlushLevel {spdlog::level::warn};
+    std::atomic<int64_t> mFlushIntervalMs {200};
+
+    // Synchronous path once the writer has stopped, e.g. during shutdown
+    std::mutex mDirectMutex;
+
+    void writerLoop();
+    std::size_t writeBatch(bool &shouldFlush);
+    void writeRecord(const LogRecord &record);
+    void reportDropped();
+    void flushSinks();
+
+  public:
+    AsyncLogSink(std::vector<spdlog::sink_ptr> sinks,
+                 const LogFlushPolicy &policy);
+    ~AsyncLogSink() override;
+
+    void start();
+
+    // Writes out everything queued, then joins the writer. Later messages
+    // go straight to the sinks on the calling thread.
+    void stop();
+
+    void setFlushPolicy(const LogFlushPolicy &policy);
+
+    std::size_t queueSizeApprox() const { return mQueue.sizeApprox(); };
+
+    // Every message dropped since the sink was created
+    uint64_t droppedTotal() const {
+        return mDroppedTotal.load(std::memory_order_relaxed);
+    };
+
+    // spdlog::sinks::sink
+    void log(const spdlog::details::log_msg &msg) override;
+    void flush() override;
+
+    // NOTE: Formatting belongs to the backend sinks, each keeps its own
+    // pattern
+    void set_pattern(const std::string &) override {};
+    void set_formatter(std::unique_ptr<spdlog::formatter>) override {};
+};
+}; // namespace FTL
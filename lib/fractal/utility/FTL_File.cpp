@@ -0,0 +1,21 @@
+#include "FTL_File.h"
+#include "FTL_Log.h"
+
+namespace FTL {
+std::vector<char> readFile(const std::string &fileName) {
+    std::ifstream file(fileName, std::ios::ate | std::ios::binary);
+
+    if (!file.is_open()) {
+        constexpr const char *errMsg = "Failed to open file!";
+        FTL_ERROR(errMsg);
+        throw std::runtime_error(errMsg);
+    };
+
+    std::vector<char> buffer(file.tellg());
+    file.seekg(0, std::ios::beg);
+    file.read(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+    file.close();
+
+    return buffer;
+};
+}; // namespace FTL
@@ -0,0 +1,8 @@
+#pragma once
+
+#include "FTL_pch.h"
+
+namespace FTL {
+// Whole file as raw bytes, throws std::runtime_error if it cannot be opened
+std::vector<char> readFile(const std::string &fileName);
+}; // namespace FTL
@@ -4,17 +4,17 @@ namespace FTL {
 
 std::shared_ptr<spdlog::logger> Log::sErrLogger;
 std::shared_ptr<spdlog::logger> Log::sStdLogger;
-
-void Log::init() {
-    const std::vector<spdlog::sink_ptr> sinks {
-        std::make_shared<spdlog::sinks::stdout_color_sink_mt>(),
-        std::make_shared<spdlog::sinks::stderr_color_sink_mt>(),
-        std::make_shared<spdlog::sinks::basic_file_sink_mt>("logs/Fractal.log",
-                                                            true)};
-
-    const auto &stdSink  = sinks[0];
-    const auto &errSink  = sinks[1];
-    const auto &fileSink = sinks[2];
+std::shared_ptr<AsyncLogSink> Log::sAsyncSink;
+
+void Log::init(const LogFlushPolicy &policy) {
+    // NOTE: Only the async writer thread touches the stdout and file sinks,
+    // so they skip the per-sink mutex
+    const auto stdSink =
+        std::make_shared<spdlog::sinks::stdout_color_sink_st>();
+    const auto errSink =
+        std::make_shared<spdlog::sinks::stderr_color_sink_mt>();
+    const auto fileSink = std::make_shared<spdlog::sinks::basic_file_sink_st>(
+        "logs/Fractal.log", true);
 
     stdSink->set_pattern("[%D] [%T.%f] %^[%n] %v%$");
     stdSink->set_level(spdlog::level::trace);
@@ -29,9 +29,27 @@ void Log::init() {
     sErrLogger->set_level(spdlog::level::err);
     sErrLogger->flush_on(spdlog::level::err);
 
-    sStdLogger =
-        std::make_shared<spdlog::logger>("FTL::Core", begin(sinks), end(sinks));
+    sAsyncSink = std::make_shared<AsyncLogSink>(
+        std::vector<spdlog::sink_ptr> {stdSink, errSink, fileSink}, policy);
+    sAsyncSink->start();
+
+    // Flushing is up to the async sink's policy, the logger never asks
+    sStdLogger = std::make_shared<spdlog::logger>("FTL::Core", sAsyncSink);
     sStdLogger->set_level(spdlog::level::trace);
-    sStdLogger->flush_on(spdlog::level::trace);
+    sStdLogger->flush_on(spdlog::level::off);
+
+    TraceLog::start();
+};
+
+void Log::shutdown() {
+    // Trace records end up in the async sink, so they go first
+    TraceLog::stop();
+    if (sAsyncSink)
+        sAsyncSink->stop();
+};
+
+void Log::setFlushPolicy(const LogFlushPolicy &policy) {
+    if (sAsyncSink)
+        sAsyncSink->setFlushPolicy(policy);
 };
 }; // namespace FTL
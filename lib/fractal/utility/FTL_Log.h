@@ -1,54 +1,121 @@
 #pragma once
 
+#include "FTL_AsyncLogSink.h"
+#include "FTL_TraceLog.h"
 #include "FTL_pch.h"
 
 namespace FTL {
 class Log {
   public:
-    static void init();
+    static void init(const LogFlushPolicy &policy = {});
+
+    // Drains the trace buffers and the async pipeline, anything logged
+    // afterwards is written synchronously
+    static void shutdown();
+
+    static void setFlushPolicy(const LogFlushPolicy &policy);
 
     inline static std::shared_ptr<spdlog::logger> &errLogger() {
         return sErrLogger;
     };
 
     inline static std::shared_ptr<spdlog::logger> &stdLogger() {
-        spdlog::set_default_logger(sStdLogger);
         return sStdLogger;
     };
 
+    // NOTE: Errors skip the async pipeline, they usually come right before
+    // a throw and must reach stderr even if the process dies
     template <typename... Args>
-    static void logError(fmt::format_string<Args...> fmt, Args &&...args) {
-        spdlog::set_default_logger(sErrLogger);
-        SPDLOG_ERROR(fmt, args...);
+    static void logError(spdlog::source_loc source,
+                         fmt::format_string<Args...> fmt, Args &&...args) {
+        sErrLogger->log(source, spdlog::level::err, fmt,
+                        std::forward<Args>(args)...);
     };
 
     template <typename... Args>
-    static void logCritical(fmt::format_string<Args...> fmt, Args &&...args) {
-        spdlog::set_default_logger(sErrLogger);
-        SPDLOG_CRITICAL(fmt, args...);
+    static void logCritical(spdlog::source_loc source,
+                            fmt::format_string<Args...> fmt, Args &&...args) {
+        sErrLogger->log(source, spdlog::level::critical, fmt,
+                        std::forward<Args>(args)...);
     };
 
   private:
     static std::shared_ptr<spdlog::logger> sErrLogger;
     static std::shared_ptr<spdlog::logger> sStdLogger;
+    static std::shared_ptr<AsyncLogSink> sAsyncSink;
 };
 
 }; // namespace FTL
 
+#define FTL_LOG_SOURCE spdlog::source_loc {__FILE__, __LINE__, SPDLOG_FUNCTION}
+
+// NOTE: Compile-time log levels. Each module's sources are built with
+// FTL_ACTIVE_LEVEL taken from FTL_LOG_LEVEL_<MODULE> in CMake, a macro below
+// that level expands to (void)0 and its arguments are never evaluated.
+#define FTL_LEVEL_TRACE    0
+#define FTL_LEVEL_DEBUG    1
+#define FTL_LEVEL_INFO     2
+#define FTL_LEVEL_WARN     3
+#define FTL_LEVEL_ERROR    4
+#define FTL_LEVEL_CRITICAL 5
+#define FTL_LEVEL_OFF      6
+
+#ifndef FTL_ACTIVE_LEVEL
+#ifdef __FRACTAL_BUILD_RELEASE
+#define FTL_ACTIVE_LEVEL FTL_LEVEL_INFO
+#else
+#define FTL_ACTIVE_LEVEL FTL_LEVEL_TRACE
+#endif
+#endif
+
 // NOTE: Core Logging Macros
-#define FTL_TRACE(...)                                                         \
-    FTL::Log::stdLogger()->trace(__VA_ARGS__) // spdlog::trace(fmt)
+// FTL_TRACE is meant for hot paths, it only copies its arguments and leaves
+// the formatting to the TraceLog writer thread. See FTL_TraceLog.h.
+#if FTL_ACTIVE_LEVEL <= FTL_LEVEL_TRACE
+#define FTL_TRACE(format, ...)                                                 \
+    do {                                                                       \
+        static constexpr FTL::TraceSite ftlTraceSite {format, __FILE__,        \
+                                                      __LINE__,                \
+                                                      SPDLOG_FUNCTION};        \
+        if (FTL::TraceLog::isEnabled())                                        \
+            FTL::TraceLog::write(ftlTraceSite, format __VA_OPT__(, )           \
+                                                   __VA_ARGS__);               \
+    } while (0)
+#else
+#define FTL_TRACE(...) (void)0
+#endif
 
+#if FTL_ACTIVE_LEVEL <= FTL_LEVEL_DEBUG
 #define FTL_DEBUG(...)                                                         \
     FTL::Log::stdLogger()->debug(__VA_ARGS__) // spdlog::debug(fmt)
+#else
+#define FTL_DEBUG(...) (void)0
+#endif
 
+#if FTL_ACTIVE_LEVEL <= FTL_LEVEL_INFO
 #define FTL_INFO(...)                                                          \
     FTL::Log::stdLogger()->info(__VA_ARGS__) // spdlog::info(fmt)
+#else
+#define FTL_INFO(...) (void)0
+#endif
 
+#if FTL_ACTIVE_LEVEL <= FTL_LEVEL_WARN
 #define FTL_WARN(...)                                                          \
     FTL::Log::stdLogger()->warn(__VA_ARGS__) // spdlog::warn(fmt)
+#else
+#define FTL_WARN(...) (void)0
+#endif
 
-#define FTL_ERROR(...) FTL::Log::logError(__VA_ARGS__) // spdlog::error(fmt)
+#if FTL_ACTIVE_LEVEL <= FTL_LEVEL_ERROR
+#define FTL_ERROR(...)                                                         \
+    FTL::Log::logError(FTL_LOG_SOURCE, __VA_ARGS__) // spdlog::error(fmt)
+#else
+#define FTL_ERROR(...) (void)0
+#endif
 
+#if FTL_ACTIVE_LEVEL <= FTL_LEVEL_CRITICAL
 #define FTL_CRITICAL(...)                                                      \
-    FTL::Log::logCritical(__VA_ARGS__) // spdlog::critical(fmt)
+    FTL::Log::logCritical(FTL_LOG_SOURCE, __VA_ARGS__) // spdlog::critical(fmt)
+#else
+#define FTL_CRITICAL(...) (void)0
+#endif
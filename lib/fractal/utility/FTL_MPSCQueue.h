@@ -0,0 +1,86 @@
+#pragma once
+
+#include "FTL_pch.h"
+
+namespace FTL {
+// NOTE: Bounded, lock-free multi-producer/single-consumer ring. Any thread
+// may call tryPush(), exactly one thread may call tryPop(). Every slot
+// carries a sequence number, a producer claims a slot with one CAS on the
+// head and publishes it by advancing the slot's sequence, so a producer
+// that stalls halfway only holds up the consumer, never other producers.
+template <typename T, std::size_t Capacity> class MPSCQueue {
+    static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0,
+                  "MPSCQueue capacity must be a power of two");
+
+  private:
+    static constexpr std::size_t CacheLineSize = 64;
+    static constexpr std::size_t IndexMask     = Capacity - 1;
+
+    struct Slot {
+        std::atomic<std::size_t> sequence {0};
+        T value {};
+    };
+
+    alignas(CacheLineSize) std::atomic<std::size_t> mHead {0};
+    alignas(CacheLineSize) std::atomic<std::size_t> mTail {0};
+    alignas(CacheLineSize) std::array<Slot, Capacity> mSlots {};
+
+  public:
+    MPSCQueue() {
+        for (std::size_t i = 0; i < Capacity; i++)
+            mSlots[i].sequence.store(i, std::memory_order_relaxed);
+    };
+
+    MPSCQueue(const MPSCQueue &)            = delete;
+    MPSCQueue &operator=(const MPSCQueue &) = delete;
+
+    // Producer side, fails instead of waiting when the ring is full
+    template <typename Writer> bool tryEmplace(Writer &&write) {
+        std::size_t head = mHead.load(std::memory_order_relaxed);
+        Slot *slot       = nullptr;
+        while (true) {
+            slot = &mSlots[head & IndexMask];
+
+            // Ahead of the slot's sequence means the consumer has not freed
+            // it yet, behind means another producer claimed it first
+            const std::ptrdiff_t lag = static_cast<std::ptrdiff_t>(
+                slot->sequence.load(std::memory_order_acquire) - head);
+            if (lag == 0) {
+                if (mHead.compare_exchange_weak(head, head + 1,
+                                                std::memory_order_relaxed))
+                    break;
+            } else if (lag < 0) {
+                return false;
+            } else {
+                head = mHead.load(std::memory_order_relaxed);
+            }
+        }
+
+        write(slot->value);
+        slot->sequence.store(head + 1, std::memory_order_release);
+        return true;
+    };
+
+    bool tryPush(const T &value) {
+        return tryEmplace([&value](T &slot) { slot = value; });
+    };
+
+    // Consumer side
+    bool tryPop(T &value) {
+        const std::size_t tail = mTail.load(std::memory_order_relaxed);
+        Slot &slot             = mSlots[tail & IndexMask];
+        if (slot.sequence.load(std::memory_order_acquire) != tail + 1)
+            return false;
+
+        value = std::move(slot.value);
+        slot.sequence.store(tail + Capacity, std::memory_order_release);
+        mTail.store(tail + 1, std::memory_order_relaxed);
+        return true;
+    };
+
+    std::size_t sizeApprox() const {
+        return mHead.load(std::memory_order_relaxed) -
+               mTail.load(std::memory_order_relaxed);
+    };
+};
+}; // namespace FTL
@@ -0,0 +1,56 @@
+#pragma once
+
+#include "FTL_pch.h"
+
+namespace FTL {
+// NOTE: Bounded, lock-free single-producer/single-consumer ring. Exactly one
+// thread may call tryPush() and exactly one other thread may call tryPop().
+template <typename T, std::size_t Capacity> class SPSCQueue {
+    static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0,
+                  "SPSCQueue capacity must be a power of two");
+
+  private:
+    static constexpr std::size_t CacheLineSize = 64;
+    static constexpr std::size_t IndexMask     = Capacity - 1;
+
+    alignas(CacheLineSize) std::atomic<std::size_t> mHead {0};
+    alignas(CacheLineSize) std::size_t mCachedTail {0};
+    alignas(CacheLineSize) std::atomic<std::size_t> mTail {0};
+    alignas(CacheLineSize) std::size_t mCachedHead {0};
+    std::array<T, Capacity> mSlots {};
+
+  public:
+    // Producer side
+    bool tryPush(const T &value) {
+        const std::size_t head = mHead.load(std::memory_order_relaxed);
+        if (head - mCachedTail == Capacity) {
+            mCachedTail = mTail.load(std::memory_order_acquire);
+            if (head - mCachedTail == Capacity)
+                return false;
+        }
+
+        mSlots[head & IndexMask] = value;
+        mHead.store(head + 1, std::memory_order_release);
+        return true;
+    };
+
+    // Consumer side
+    bool tryPop(T &value) {
+        const std::size_t tail = mTail.load(std::memory_order_relaxed);
+        if (tail == mCachedHead) {
+            mCachedHead = mHead.load(std::memory_order_acquire);
+            if (tail == mCachedHead)
+                return false;
+        }
+
+        value = mSlots[tail & IndexMask];
+        mTail.store(tail + 1, std::memory_order_release);
+        return true;
+    };
+
+    std::size_t sizeApprox() const {
+        return mHead.load(std::memory_order_relaxed) -
+               mTail.load(std::memory_order_relaxed);
+    };
+};
+}; // namespace FTL
@@ -0,0 +1,191 @@
+#include "FTL_TraceLog.h"
+#include "FTL_Log.h"
+
+namespace {
+// NOTE: How often the writer looks at the thread buffers, a buffer holds
+// well over a frame's worth of records at this rate
+constexpr std::chrono::milliseconds WriterInterval(5);
+
+struct ThreadTraceBuffer {
+    FTL::TraceBuffer *buffer = nullptr;
+
+    // The writer frees the buffer once it has drained what is left
+    ~ThreadTraceBuffer() {
+        if (buffer != nullptr)
+            buffer->retire();
+    };
+};
+
+thread_local ThreadTraceBuffer tThreadBuffer;
+}; // namespace
+
+namespace FTL {
+std::byte *TraceBuffer::reserve(std::size_t size) {
+    const std::size_t head   = mHead.load(std::memory_order_relaxed);
+    const std::size_t offset = head & (Capacity - 1);
+
+    // Records never straddle the end of the ring
+    const std::size_t padding = (Capacity - offset < size) ? Capacity - offset
+                                                           : 0;
+    if (head + padding + size - mCachedTail > Capacity) {
+        mCachedTail = mTail.load(std::memory_order_acquire);
+        if (head + padding + size - mCachedTail > Capacity)
+            return nullptr;
+    }
+
+    // NOTE: A gap too small for a header is skipped by the consumer anyway
+    if (padding >= sizeof(TraceRecordHeader)) {
+        const TraceRecordHeader marker {static_cast<uint32_t>(padding), 0,
+                                        nullptr, nullptr, 0};
+        std::memcpy(&mData[offset], &marker, sizeof(marker));
+    }
+
+    mReservedPadding = padding;
+    return &mData[(head + padding) & (Capacity - 1)];
+};
+
+void TraceBuffer::commit(std::size_t size) {
+    const std::size_t head = mHead.load(std::memory_order_relaxed);
+    mHead.store(head + mReservedPadding + size, std::memory_order_release);
+    mReservedPadding = 0;
+};
+
+const TraceRecordHeader *TraceBuffer::peek() {
+    const std::size_t head = mHead.load(std::memory_order_acquire);
+    std::size_t tail       = mTail.load(std::memory_order_relaxed);
+
+    while (tail != head) {
+        const std::size_t offset    = tail & (Capacity - 1);
+        const std::size_t remaining = Capacity - offset;
+        if (remaining < sizeof(TraceRecordHeader)) {
+            tail += remaining;
+            mTail.store(tail, std::memory_order_release);
+            continue;
+        }
+
+        const TraceRecordHeader *record =
+            reinterpret_cast<const TraceRecordHeader *>(&mData[offset]);
+        if (record->site != nullptr)
+            return record;
+
+        tail += record->size;
+        mTail.store(tail, std::memory_order_release);
+    }
+    return nullptr;
+};
+
+void TraceBuffer::release(const TraceRecordHeader *record) {
+    const std::size_t tail = mTail.load(std::memory_order_relaxed);
+    mTail.store(tail + record->size, std::memory_order_release);
+};
+
+std::atomic<bool> TraceLog::sIsEnabled {false};
+std::mutex TraceLog::sBuffersMutex;
+std::vector<std::unique_ptr<TraceBuffer>> TraceLog::sBuffers;
+std::thread TraceLog::sWriterThread;
+std::atomic<bool> TraceLog::sIsRunning {false};
+
+void TraceLog::start() {
+    if (sIsRunning.exchange(true))
+        return;
+
+    sWriterThread = std::thread(&TraceLog::writerLoop);
+    setEnabled(true);
+};
+
+void TraceLog::stop() {
+    if (!sIsRunning.exchange(false))
+        return;
+
+    setEnabled(false);
+    sWriterThread.join();
+    drainBuffers();
+};
+
+TraceBuffer &TraceLog::threadBuffer() {
+    if (tThreadBuffer.buffer == nullptr)
+        tThreadBuffer.buffer = registerThread();
+
+    return *tThreadBuffer.buffer;
+};
+
+TraceBuffer *TraceLog::registerThread() {
+    std::lock_guard<std::mutex> lock(sBuffersMutex);
+    sBuffers.push_back(
+        std::make_unique<TraceBuffer>(spdlog::details::os::thread_id()));
+    return sBuffers.back().get();
+};
+
+void TraceLog::writerLoop() {
+    while (sIsRunning.load(std::memory_order_acquire)) {
+        if (!drainBuffers())
+            std::this_thread::sleep_for(WriterInterval);
+    }
+};
+
+// NOTE: Bypasses logger::log() so each record keeps the thread id of the
+// thread that traced it rather than the writer's
+bool TraceLog::drainBuffers() {
+    const std::shared_ptr<spdlog::logger> &logger = Log::stdLogger();
+    const bool isLogged =
+        logger != nullptr && logger->should_log(spdlog::level::trace);
+
+    // NOTE: Formats without the lock, so a thread registering its first
+    // buffer never waits on a drain. Only the writer erases buffers, the
+    // pointers stay valid until it does.
+    std::vector<TraceBuffer *> buffers;
+    {
+        std::lock_guard<std::mutex> lock(sBuffersMutex);
+        buffers.reserve(sBuffers.size());
+        for (const std::unique_ptr<TraceBuffer> &buffer : sBuffers)
+            buffers.push_back(buffer.get());
+    }
+
+    bool hasWritten = false;
+    fmt::memory_buffer text;
+    std::vector<TraceBuffer *> retired;
+    for (TraceBuffer *buffer : buffers) {
+        const bool isRetired = buffer->isRetired();
+
+        while (const TraceRecordHeader *record = buffer->peek()) {
+            if (isLogged) {
+                const TraceSite &site = *record->site;
+                text.clear();
+                record->decode(reinterpret_cast<const std::byte *>(record + 1),
+                               site.format, text);
+
+                spdlog::details::log_msg msg(
+                    spdlog::log_clock::time_point(
+                        spdlog::log_clock::duration(record->time)),
+                    spdlog::source_loc {site.file, site.line, site.function},
+                    logger->name(), spdlog::level::trace,
+                    spdlog::string_view_t(text.data(), text.size()));
+                msg.thread_id = buffer->threadId();
+                for (const spdlog::sink_ptr &sink : logger->sinks())
+                    sink->log(msg);
+            }
+            buffer->release(record);
+            hasWritten = true;
+        }
+
+        const uint64_t dropped = buffer->takeDropped();
+        if (dropped != 0 && logger != nullptr)
+            logger->warn("{} trace records dropped on thread {}, its trace "
+                         "buffer was full",
+                         dropped, buffer->threadId());
+
+        if (isRetired)
+            retired.push_back(buffer);
+    }
+
+    if (!retired.empty()) {
+        std::lock_guard<std::mutex> lock(sBuffersMutex);
+        std::erase_if(sBuffers,
+                      [&retired](const std::unique_ptr<TraceBuffer> &buffer) {
+                          return std::find(retired.begin(), retired.end(),
+                                           buffer.get()) != retired.end();
+                      });
+    }
+    return hasWritten;
+};
+}; // namespace FTL
@@ -0,0 +1,226 @@
+#pragma once
+
+#include "FTL_pch.h"
+
+#include <mutex>
+#include <string>
+#include <tuple>
+#include <type_traits>
+
+namespace FTL {
+// NOTE: One per FTL_TRACE call site, a constant-initialized static, so the
+// site costs nothing at runtime and its address identifies it
+struct TraceSite {
+    const char *format;
+    const char *file;
+    int line;
+    const char *function;
+};
+
+using TraceDecodeFn = void (*)(const std::byte *args, const char *format,
+                               fmt::memory_buffer &out);
+
+// How each argument type is copied into a trace buffer and read back.
+// Trivially copyable values are copied as raw bytes, strings as a length
+// and their characters. Pointers other than C strings are not accepted,
+// whatever they point to may be gone by the time the writer formats.
+template <typename T> struct TraceArg {
+    static_assert(std::is_trivially_copyable_v<T> && !std::is_pointer_v<T>,
+                  "FTL_TRACE arguments must be trivially copyable values or "
+                  "strings");
+    using Decoded = T;
+
+    static std::size_t size(const T &) { return sizeof(T); };
+    static std::byte *write(std::byte *out, const T &value) {
+        std::memcpy(out, &value, sizeof(T));
+        return out + sizeof(T);
+    };
+    static T read(const std::byte *&in) {
+        T value;
+        std::memcpy(&value, in, sizeof(T));
+        in += sizeof(T);
+        return value;
+    };
+};
+
+struct TraceStringArg {
+    using Decoded = std::string_view;
+
+    static std::size_t size(std::string_view value) {
+        return sizeof(uint32_t) + value.size();
+    };
+    static std::byte *write(std::byte *out, std::string_view value) {
+        const uint32_t length = static_cast<uint32_t>(value.size());
+        std::memcpy(out, &length, sizeof(length));
+        std::memcpy(out + sizeof(length), value.data(), length);
+        return out + sizeof(length) + length;
+    };
+    static std::string_view read(const std::byte *&in) {
+        uint32_t length;
+        std::memcpy(&length, in, sizeof(length));
+        const char *data = reinterpret_cast<const char *>(in + sizeof(length));
+        in += sizeof(length) + length;
+        return std::string_view(data, length);
+    };
+};
+
+// NOTE: A null C string is traced as "(null)", std::string_view must not
+// be constructed from one
+struct TraceCStringArg : TraceStringArg {
+    static std::string_view view(const char *value) {
+        return (value != nullptr) ? std::string_view(value)
+                                  : std::string_view("(null)");
+    };
+    static std::size_t size(const char *value) {
+        return TraceStringArg::size(view(value));
+    };
+    static std::byte *write(std::byte *out, const char *value) {
+        return TraceStringArg::write(out, view(value));
+    };
+};
+
+template <> struct TraceArg<const char *> : TraceCStringArg {};
+template <> struct TraceArg<char *> : TraceCStringArg {};
+template <> struct TraceArg<std::string> : TraceStringArg {};
+template <> struct TraceArg<std::string_view> : TraceStringArg {};
+
+// NOTE: The reads happen in argument order, braced initialization
+// guarantees left-to-right evaluation
+template <typename... Args>
+void decodeTrace([[maybe_unused]] const std::byte *args, const char *format,
+                 fmt::memory_buffer &out) {
+    const std::tuple<typename TraceArg<Args>::Decoded...> values {
+        TraceArg<Args>::read(args)...};
+    std::apply(
+        [&](const auto &...value) {
+            fmt::vformat_to(fmt::appender(out), format,
+                            fmt::make_format_args(value...));
+        },
+        values);
+};
+
+struct TraceRecordHeader {
+    uint32_t size; // Whole record, header included, multiple of 8
+    uint32_t reserved;
+    const TraceSite *site; // nullptr marks padding up to the end of the ring
+    TraceDecodeFn decode;
+    int64_t time; // spdlog::log_clock ticks
+};
+
+// NOTE: Bounded single-producer/single-consumer byte ring owned by one
+// thread. Records never wrap, when one does not fit before the end the
+// rest is skipped with a padding record.
+class TraceBuffer {
+  public:
+    static constexpr std::size_t Capacity = 1 << 16;
+
+  private:
+    static constexpr std::size_t CacheLineSize = 64;
+
+    alignas(CacheLineSize) std::atomic<std::size_t> mHead {0};
+    alignas(CacheLineSize) std::size_t mCachedTail {0};
+    alignas(CacheLineSize) std::atomic<std::size_t> mTail {0};
+    alignas(CacheLineSize) std::array<std::byte, Capacity> mData;
+
+    std::size_t mReservedPadding {0};
+    std::atomic<uint64_t> mDroppedCount {0}; // Since the last takeDropped()
+    std::atomic<uint64_t> mDroppedTotal {0};
+    std::atomic<bool> mIsRetired {false};
+    std::size_t mThreadId;
+
+  public:
+    explicit TraceBuffer(std::size_t threadId) : mThreadId(threadId) {};
+
+    // Producer side, nullptr when the record does not fit right now
+    std::byte *reserve(std::size_t size);
+    void commit(std::size_t size);
+    void drop() {
+        mDroppedCount.fetch_add(1, std::memory_order_relaxed);
+        mDroppedTotal.fetch_add(1, std::memory_order_relaxed);
+    };
+
+    // Bytes the consumer has not released yet
+    std::size_t sizeApprox() const {
+        return mHead.load(std::memory_order_relaxed) -
+               mTail.load(std::memory_order_acquire);
+    };
+
+    // Every record dropped since the buffer was created
+    uint64_t droppedTotal() const {
+        return mDroppedTotal.load(std::memory_order_relaxed);
+    };
+
+    // Consumer side
+    const TraceRecordHeader *peek();
+    void release(const TraceRecordHeader *record);
+    uint64_t takeDropped() {
+        return mDroppedCount.exchange(0, std::memory_order_relaxed);
+    };
+
+    void retire() { mIsRetired.store(true, std::memory_order_release); };
+    bool isRetired() const {
+        return mIsRetired.load(std::memory_order_acquire);
+    };
+    std::size_t threadId() const { return mThreadId; };
+};
+
+// NOTE: Deferred-formatting path behind FTL_TRACE. A call copies the site
+// pointer, a decoder, a timestamp and the raw arguments into the calling
+// thread's TraceBuffer. A background thread decodes the records, formats
+// them and hands them to the standard logger, so trace output is ordered
+// per thread but may interleave with other log levels.
+class TraceLog {
+  private:
+    static std::atomic<bool> sIsEnabled;
+    static std::mutex sBuffersMutex;
+    static std::vector<std::unique_ptr<TraceBuffer>> sBuffers;
+    static std::thread sWriterThread;
+    static std::atomic<bool> sIsRunning;
+
+    static TraceBuffer *registerThread();
+    static void writerLoop();
+    static bool drainBuffers();
+
+  public:
+    static void start();
+    static void stop();
+
+    static bool isEnabled() {
+        return sIsEnabled.load(std::memory_order_relaxed);
+    };
+    static void setEnabled(bool isEnabled) {
+        sIsEnabled.store(isEnabled, std::memory_order_relaxed);
+    };
+
+    static TraceBuffer &threadBuffer();
+
+    // NOTE: The format string is only there for fmt to check it against
+    // the arguments at compile time, the site's copy is what gets used
+    template <typename... Args>
+    static void write(const TraceSite &site,
+                      fmt::format_string<const Args &...>,
+                      const Args &...args) {
+        constexpr std::size_t HeaderSize = sizeof(TraceRecordHeader);
+        const std::size_t argsSize = (std::size_t {0} + ... +
+                                      TraceArg<std::decay_t<Args>>::size(args));
+        const std::size_t size = (HeaderSize + argsSize + 7) & ~std::size_t(7);
+
+        TraceBuffer &buffer = threadBuffer();
+        std::byte *out      = buffer.reserve(size);
+        if (out == nullptr) {
+            buffer.drop();
+            return;
+        }
+
+        const TraceRecordHeader header {
+            static_cast<uint32_t>(size), 0, &site,
+            &decodeTrace<std::decay_t<Args>...>,
+            spdlog::log_clock::now().time_since_epoch().count()};
+        std::memcpy(out, &header, HeaderSize);
+
+        out += HeaderSize;
+        ((out = TraceArg<std::decay_t<Args>>::write(out, args)), ...);
+        buffer.commit(size);
+    };
+};
+}; // namespace FTL
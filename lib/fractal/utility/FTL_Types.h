@@ -2,4 +2,31 @@
 
 #include "FTL_pch.h"
 
-namespace FTL {}; // namespace FTL
+namespace FTL {
+// NOTE: Region of the complex plane currently on screen
+struct View {
+    double centerX {-0.5};
+    double centerY {0.0};
+    double height {3.0}; // complex-plane units spanned by the viewport height
+    uint32_t maxIterations {256};
+};
+
+enum class ViewCommandType : uint8_t {
+    Redraw,
+    Pan,             // x, y: framebuffer pixel delta
+    Zoom,            // x, y: framebuffer pixel anchor, value: zoom factor
+    ScaleIterations, // value: multiplier applied to the iteration limit
+    Reset,
+    ToggleKernel,
+    Iconify, // value: 1.0 when iconified, 0.0 when restored
+    Quit,
+};
+
+// NOTE: Posted by the event thread, drained by the render thread
+struct ViewCommand {
+    ViewCommandType type {ViewCommandType::Redraw};
+    double x {0.0};
+    double y {0.0};
+    double value {0.0};
+};
+}; // namespace FTL
@@ -1,10 +1,43 @@
 #include "gtfo_profiler.h"
 #include <Fractal.h>
 
+#include <string_view>
+
 #ifdef __FRACTAL_PLATFORM_LINUX
 int main(int argc, char *argv[]) {
     FTL::Application *app = new FTL::Application();
 
+    // NOTE: --benchmark <script> [--report <path>] runs headless and exits,
+    // --golden <dir>, --baseline <path> and --max-slowdown <percent> turn on
+    // the regression checks and make the exit code report them. --record
+    // writes the goldens and baseline instead of checking them.
+    FTL::BenchmarkOptions benchmark;
+    for (int i = 1; i < argc; i++) {
+        const std::string_view arg(argv[i]);
+        const bool hasValue = i + 1 < argc;
+        if (arg == "--record")
+            benchmark.isRecording = true;
+        else if (arg == "--benchmark" && hasValue)
+            benchmark.scriptPath = argv[++i];
+        else if (arg == "--report" && hasValue)
+            benchmark.reportPath = argv[++i];
+        else if (arg == "--golden" && hasValue)
+            benchmark.goldenDir = argv[++i];
+        else if (arg == "--baseline" && hasValue)
+            benchmark.baselinePath = argv[++i];
+        else if (arg == "--max-slowdown" && hasValue)
+            benchmark.maxSlowdownPercent = std::stod(argv[++i]);
+    };
+
+    if (!benchmark.scriptPath.empty()) {
+        GTFO_PROFILE_SESSION_START("AppBenchmark", "logs/FTLAppBenchmark.json");
+        const bool hasPassed = app->runBenchmark(benchmark);
+        GTFO_PROFILE_SESSION_END();
+
+        delete app;
+        return hasPassed ? EXIT_SUCCESS : EXIT_FAILURE;
+    };
+
     GTFO_PROFILE_SESSION_START("AppInit", "logs/FTLAppInit.json");
     app->init();
     GTFO_PROFILE_SESSION_END();